@@ -12,14 +12,12 @@
 #include "SubInstruction.h"
 #include "../pkb.h"
 
-class TNode;
-
 namespace query {
     class Instruction {
     public:
         std::vector<std::string> select_variables;
         std::vector<SubInstruction> sub_instructions;
-        std::vector<std::unordered_map<std::string, std::shared_ptr<TNode> > > variable_result;
+        std::vector<std::unordered_map<std::string, TNode> > variable_result;
         std::unordered_map<std::string, std::string> variable_types;
         bool same_values_cond = false;
 
@@ -115,18 +113,21 @@ namespace query {
         }
 
         void process_query() {
-            using Binding = std::unordered_map<std::string, std::shared_ptr<TNode> >;
+            using Binding = std::unordered_map<std::string, TNode>;
             std::vector<Binding> partialResults = {{}};
 
             // Sort clauses to start with the most restrictive ones
             std::vector<SubInstruction> sorted_subs = sub_instructions;
             std::sort(sorted_subs.begin(), sorted_subs.end(), [](const SubInstruction &a, const SubInstruction &b) {
-                return get_relation_data(a.relation).size() < get_relation_data(b.relation).size();
+                return get_relation_size(a.relation) < get_relation_size(b.relation);
             });
 
             for (const auto &sub: sorted_subs) {
-                const auto &rel_data = get_relation_data(sub.relation);
                 std::vector<Binding> newResults;
+                const TNode left_literal = resolve_stmt_literal(sub.left_param);
+                const TNode right_literal = resolve_stmt_literal(sub.right_param);
+                std::vector<std::pair<TNode, TNode> > enumerated;
+                const auto &rel_data = get_relation_data(sub.relation, left_literal, right_literal, enumerated);
 
                 for (const auto &[left, right]: rel_data) {
                     for (const auto &binding: partialResults) {
@@ -136,15 +137,14 @@ namespace query {
                         // Handling left parameter
                         if (is_variable(sub.left_param)) {
                             if (newBinding.count(sub.left_param)) {
-                                if (newBinding[sub.left_param]->get_node()->mLineNumber != left.get_node()->
-                                    mLineNumber) {
+                                if (!PKB::same_reference(newBinding[sub.left_param], left)) {
                                     continue; // conflict, skip
                                 }
                             } else {
-                                newBinding[sub.left_param] = std::make_shared<TNode>(left);
+                                newBinding[sub.left_param] = left;
                             }
                         } else {
-                            if (std::to_string(left.get_node()->mLineNumber) != sub.left_param) {
+                            if (left != left_literal) {
                                 continue; // literal doesn't match
                             }
                         }
@@ -152,15 +152,14 @@ namespace query {
                         // Handling right parameter
                         if (is_variable(sub.right_param)) {
                             if (newBinding.count(sub.right_param)) {
-                                if (newBinding[sub.right_param]->get_node()->mLineNumber != right.get_node()->
-                                    mLineNumber) {
+                                if (!PKB::same_reference(newBinding[sub.right_param], right)) {
                                     continue;
                                 }
                             } else {
-                                newBinding[sub.right_param] = std::make_shared<TNode>(right);
+                                newBinding[sub.right_param] = right;
                             }
                         } else {
-                            if (std::to_string(right.get_node()->mLineNumber) != sub.right_param) {
+                            if (right != right_literal) {
                                 continue;
                             }
                         }
@@ -176,7 +175,7 @@ namespace query {
                                 break;
                             }
 
-                            auto node = newBinding[syn]->get_node();
+                            const TNode node = newBinding[syn];
 
                             if (is_variable(val)) {
                                 if (!newBinding.count(val)) {
@@ -184,14 +183,14 @@ namespace query {
                                     break;
                                 }
 
-                                auto val_node = newBinding[val]->get_node();
+                                const TNode val_node = newBinding[val];
                                 if (attr == "stmt#" || attr == "value") {
-                                    if (node->mLineNumber != val_node->mLineNumber) {
+                                    if (!PKB::same_reference(node, val_node)) {
                                         valid = false;
                                         break;
                                     }
                                 } else if (attr == "procName" || attr == "varName") {
-                                    if (node->mLineNumber != val_node->mLineNumber) {
+                                    if (node.get_name() != val_node.get_name()) {
                                         valid = false;
                                         break;
                                     }
@@ -202,12 +201,13 @@ namespace query {
                             } else {
                                 // Literal value
                                 if (attr == "stmt#" || attr == "value") {
-                                    if (std::to_string(node->mLineNumber) != val) {
+                                    if (PKB::get_reference(node) != val) {
                                         valid = false;
                                         break;
                                     }
                                 } else if (attr == "procName" || attr == "varName") {
-                                    if (std::to_string(node->mLineNumber) != val) {
+                                    NameId name = node.get_name();
+                                    if (name == NameTable::NONE || name != NameTable::instance().find(val)) {
                                         valid = false;
                                         break;
                                     }
@@ -256,17 +256,16 @@ namespace query {
                         auto syn_type_it = variable_types.find(select);
 
                         if (syn_type_it != variable_types.end() && syn_type_it->second == "variable") {
-                            result_line << node->to_string();
+                            result_line << node.to_string();
                             numeric_values.push_back(0); // treat as 0 for sorting
                         } else if (
                             syn_type_it != variable_types.end() && syn_type_it->second == "procedure"
                         ) {
-                            result_line << node->get_node()->mLineNumber;
+                            result_line << PKB::get_reference(node);
                             numeric_values.push_back(0); // treat as 0 for sorting
                         } else {
-                            int line = node->get_node()->mLineNumber;
-                            result_line << line;
-                            numeric_values.push_back(line);
+                            result_line << PKB::get_reference(node);
+                            numeric_values.push_back(PKB::is_statement(node) ? node.get_command_no() : 0);
                         }
                     } else {
                         result_line << "null";
@@ -304,6 +303,15 @@ namespace query {
             return !param.empty() && isalpha(param[0]) && param != "BOOLEAN";
         }
 
+        // statement a literal argument like the 3 in Follows(3, s) refers to, looked up by stmt#;
+        // a TNode referring to no node for synonyms and numbers that are not a stmt#
+        static TNode resolve_stmt_literal(const std::string &param) {
+            if (param.empty() || param.size() > 9 || !std::all_of(param.begin(), param.end(), ::isdigit)) {
+                return TNode();
+            }
+            return PKB::instance().get_stmt(std::stoul(param));
+        }
+
         static const std::vector<std::pair<TNode, TNode> > &get_relation_data(const std::string &rel) {
             if (rel == "Uses") return *PKB::usesRelations;
             if (rel == "Modifies") return *PKB::modifiesRelations;
@@ -319,6 +327,37 @@ namespace query {
             static const std::vector<std::pair<TNode, TNode> > empty;
             return empty;
         }
+
+        // relations the PKB does not store are enumerated into `enumerated`, only the pairs the literals allow;
+        // so are the pairs of a stored relation a statement literal picks, looked up by the literal's node
+        static const std::vector<std::pair<TNode, TNode> > &get_relation_data(
+            const std::string &rel, const TNode left_literal, const TNode right_literal,
+            std::vector<std::pair<TNode, TNode> > &enumerated) {
+            if (rel == "Parent*" && !PKB::instance().is_parent_star_materialized()) {
+                PKB::instance().get_parent_star_pairs(left_literal, right_literal, enumerated);
+                return enumerated;
+            }
+            if (rel == "Follows*" && !PKB::instance().is_follows_star_materialized()) {
+                PKB::instance().get_follows_star_pairs(left_literal, right_literal, enumerated);
+                return enumerated;
+            }
+            const auto &stored = get_relation_data(rel);
+            if ((left_literal || right_literal) && !stored.empty()) {
+                PKB::instance().get_relation_pairs(stored, left_literal, right_literal, enumerated);
+                return enumerated;
+            }
+            return stored;
+        }
+
+        static size_t get_relation_size(const std::string &rel) {
+            if (rel == "Parent*") {
+                return PKB::instance().get_parent_star_size();
+            }
+            if (rel == "Follows*") {
+                return PKB::instance().get_follows_star_size();
+            }
+            return get_relation_data(rel).size();
+        }
     };
 } // namespace query
 
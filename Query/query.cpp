@@ -25,52 +25,52 @@ namespace query {
     void print_relations() {
         std::cout << "\nFollows" << std::endl;
         for (const auto &[left, right]: *PKB::followsRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nFollows*" << std::endl;
         for (const auto &[left, right]: *PKB::followsTRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nParent" << std::endl;
         for (const auto &[left, right]: *PKB::parentRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nParent*" << std::endl;
         for (const auto &[left, right]: *PKB::parentTRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nModifies" << std::endl;
         for (const auto &[left, right]: *PKB::modifiesRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.to_string() << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << right.to_string() << "), ";
         }
 
         std::cout << "\nUses" << std::endl;
         for (const auto &[left, right]: *PKB::usesRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.to_string() << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << right.to_string() << "), ";
         }
 
         std::cout << "\nCalls" << std::endl;
         for (const auto &[left, right]: *PKB::callsRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nCallsT" << std::endl;
         for (const auto &[left, right]: *PKB::callsTRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nNext" << std::endl;
         for (const auto &[left, right]: *PKB::nextRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << "\nNext*" << std::endl;
         for (const auto &[left, right]: *PKB::nextTRelations) {
-            std::cout << "(" << left.get_node()->mLineNumber << ": " << right.get_node()->mLineNumber << "), ";
+            std::cout << "(" << PKB::get_reference(left) << ": " << PKB::get_reference(right) << "), ";
         }
 
         std::cout << std::endl;
@@ -0,0 +1,31 @@
+#include "arena.h"
+
+#include <algorithm>
+
+void Arena::add_block(size_t min_size) {
+    size_t size = std::max(next_block_size, min_size + sizeof(Block));
+    auto *block = static_cast<Block *>(::operator new(size));
+    block->next = blocks;
+    blocks = block;
+    cursor = reinterpret_cast<char *>(block) + sizeof(Block);
+    limit = reinterpret_cast<char *>(block) + size;
+    reserved += size;
+    next_block_size = std::min<size_t>(size * 2, 1 << 20);
+}
+
+void Arena::release() {
+    for (DestructorEntry *entry = destructors; entry != nullptr; entry = entry->next) {
+        entry->destroy(entry->object);
+    }
+    for (Block *block = blocks; block != nullptr;) {
+        Block *next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+    blocks = nullptr;
+    destructors = nullptr;
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+    reserved = 0;
+}
@@ -0,0 +1,113 @@
+#ifndef MINISPA_ARENA_H
+#define MINISPA_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator. Objects are placed one after another in large blocks and are never freed one by one:
+// destroying the arena runs the destructors of the objects that need one and releases the blocks.
+class Arena {
+public:
+    explicit Arena(size_t first_block_size = 4096) : next_block_size(first_block_size) {}
+
+    ~Arena() {
+        release();
+    }
+
+    Arena(Arena const &) = delete;
+
+    void operator=(Arena const &) = delete;
+
+    Arena(Arena &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    Arena &operator=(Arena &&other) noexcept {
+        if (this != &other) {
+            release();
+            blocks = std::exchange(other.blocks, nullptr);
+            destructors = std::exchange(other.destructors, nullptr);
+            cursor = std::exchange(other.cursor, nullptr);
+            limit = std::exchange(other.limit, nullptr);
+            next_block_size = other.next_block_size;
+            used = std::exchange(other.used, 0);
+            reserved = std::exchange(other.reserved, 0);
+        }
+        return *this;
+    }
+
+    void *allocate(size_t size, size_t alignment) {
+        auto address = reinterpret_cast<size_t>(cursor);
+        size_t padding = (alignment - address % alignment) % alignment;
+        if (cursor == nullptr || padding + size > static_cast<size_t>(limit - cursor)) {
+            add_block(size + alignment);
+            address = reinterpret_cast<size_t>(cursor);
+            padding = (alignment - address % alignment) % alignment;
+        }
+        void *memory = cursor + padding;
+        cursor += padding + size;
+        used += size;
+        return memory;
+    }
+
+    template<typename T, typename... Args>
+    T *make(Args &&... args) {
+        T *object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            auto *entry = new(allocate(sizeof(DestructorEntry), alignof(DestructorEntry))) DestructorEntry{
+                    object, [](void *pointer) { static_cast<T *>(pointer)->~T(); }, destructors};
+            destructors = entry;
+        }
+        return object;
+    }
+
+    // copy of items[0..count) placed in the arena
+    template<typename T>
+    T *copy_array(const T *items, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+        if (count == 0) {
+            return nullptr;
+        }
+        auto *copy = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+        std::copy(items, items + count, copy);
+        return copy;
+    }
+
+    // bytes handed out to objects
+    [[nodiscard]] size_t bytes_used() const {
+        return used;
+    }
+
+    // bytes of all blocks
+    [[nodiscard]] size_t bytes_reserved() const {
+        return reserved;
+    }
+
+private:
+    struct Block {
+        Block *next;
+    };
+
+    struct DestructorEntry {
+        void *object;
+        void (*destroy)(void *);
+        DestructorEntry *next;
+    };
+
+    Block *blocks = nullptr;
+    DestructorEntry *destructors = nullptr; // newest first, so objects are destroyed in reverse order
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    size_t next_block_size;
+    size_t used = 0;
+    size_t reserved = 0;
+
+    void add_block(size_t min_size);
+
+    void release();
+};
+
+#endif //MINISPA_ARENA_H
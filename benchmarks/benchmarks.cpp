@@ -0,0 +1,1215 @@
+//
+// Parser / PKB benchmarks on generated SIMPLE programs.
+// usage: MiniSPA_benchmarks [scenario ...]   (no arguments runs every scenario)
+//
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "benchmark_tool.h"
+#include "../parser.h"
+#include "../source_buffer.h"
+#include "../source_stream.h"
+#include "../lexer_scan.h"
+#include "../thread_pool.h"
+#include "../call_graph.h"
+#include "../pkb.h"
+#include "../Query/Instruction.h"
+
+// every heap allocation made by the process is counted, scenarios report the difference around the measured code;
+// the size is kept in a header in front of the block so live heap bytes can be tracked too
+static std::atomic<size_t> allocation_count{0};
+static std::atomic<size_t> live_heap_bytes{0};
+static constexpr size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    live_heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto *block = static_cast<char *>(std::malloc(size + ALLOCATION_HEADER))) {
+        *reinterpret_cast<size_t *>(block) = size;
+        return block + ALLOCATION_HEADER;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto *block = static_cast<char *>(ptr) - ALLOCATION_HEADER;
+    live_heap_bytes.fetch_sub(*reinterpret_cast<size_t *>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace {
+    struct ProgramShape {
+        size_t procedures = 100;
+        size_t blocks_per_procedure = 4;  // every block is an assign, a while and an if (8 statements)
+        size_t variables = 64;
+        std::string variable_prefix = "v";
+        size_t calls_per_block = 0;       // extra calls after every block, to later procedures only
+        bool call_next = true;            // every procedure but the last ends calling the next one
+    };
+
+    std::string var(size_t i, const ProgramShape &shape) {
+        return shape.variable_prefix + std::to_string(i % shape.variables);
+    }
+
+    // generated procedures call the next one, so every call is a forward reference
+    std::string generate_program(const ProgramShape &shape) {
+        std::string code;
+        for (size_t p = 0; p < shape.procedures; ++p) {
+            code += "procedure P" + std::to_string(p) + " {\n";
+            for (size_t b = 0; b < shape.blocks_per_procedure; ++b) {
+                size_t k = p * 7 + b * 3;
+                code += "  " + var(k, shape) + " = " + var(k + 1, shape) + " + " + var(k + 2, shape) + " * 3;\n";
+                code += "  while " + var(k + 3, shape) + " {\n";
+                code += "    " + var(k + 4, shape) + " = " + var(k + 4, shape) + " - 1;\n";
+                code += "    " + var(k + 5, shape) + " = (" + var(k + 1, shape) + " + 2) * " + var(k + 6, shape) + "; }\n";
+                code += "  if " + var(k + 2, shape) + " then {\n";
+                code += "    " + var(k + 7, shape) + " = 0; }\n";
+                code += "  else {\n";
+                code += "    " + var(k + 8, shape) + " = " + var(k, shape) + " + 1; }\n";
+                for (size_t c = 1; c <= shape.calls_per_block && p + c < shape.procedures; ++c) {
+                    code += "  call P" + std::to_string(p + c) + ";\n";
+                }
+            }
+            if (shape.call_next && p + 1 < shape.procedures) {
+                code += "  call P" + std::to_string(p + 1) + ";\n";
+            }
+            code += "}\n";
+        }
+        return code;
+    }
+
+    size_t count_lines(const std::string &code) {
+        return std::count(code.begin(), code.end(), '\n');
+    }
+
+    // best of `runs` wall-clock times in microseconds
+    long measure_us(const std::function<void()> &setup, const std::function<void()> &body, int runs = 3) {
+        long best = -1;
+        for (int i = 0; i < runs; ++i) {
+            setup();
+            BenchmarkTool tool;
+            body();
+            tool.breakpoint(0);
+            long us = tool.breakpoints[0];
+            best = (best < 0 || us < best) ? us : best;
+        }
+        return best;
+    }
+
+    // hardware cache misses of this thread while it lives, -1 where the kernel or the machine does not count them
+    class CacheMisses {
+    public:
+        CacheMisses() {
+#if defined(__linux__)
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        ~CacheMisses() {
+#if defined(__linux__)
+            if (fd >= 0) {
+                close(fd);
+            }
+#endif
+        }
+
+        CacheMisses(CacheMisses const &) = delete;
+
+        void operator=(CacheMisses const &) = delete;
+
+        [[nodiscard]] long long count() const {
+            long long misses = -1;
+#if defined(__linux__)
+            if (fd < 0 || read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+                return -1;
+            }
+#endif
+            return misses;
+        }
+
+    private:
+        int fd = -1;
+    };
+
+    std::string format_count(long long count) {
+        return count < 0 ? "n/a" : std::to_string(count);
+    }
+
+    void bench_parse_scaling() {
+        fmt_println("parse_scaling: Parser::parse_program time vs procedure count");
+        fmt_println("{:>12} {:>10} {:>12} {:>14}", "procedures", "lines", "parse [us]", "us/procedure");
+        for (size_t procedures: {500, 1000, 2000, 4000, 8000, 16000}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            const std::string code = generate_program(shape);
+
+            auto &parser = Parser::instance();
+            long us = measure_us([&] { parser.initialize_by_raw_code(code); },
+                                 [&] { parser.parse_program(); });
+
+            fmt_println("{:>12} {:>10} {:>12} {:>14.2f}", procedures, count_lines(code), us,
+                        static_cast<double>(us) / static_cast<double>(procedures));
+        }
+    }
+
+    void bench_parse_allocations() {
+        fmt_println("parse_allocations: heap allocations made by Parser::parse_program");
+        fmt_println("{:>12} {:>18} {:>10} {:>14} {:>10}", "procedures", "variable names", "lines", "allocations",
+                    "per line");
+        for (const std::string prefix: {"v", "accumulatedValue"}) {
+            for (size_t procedures: {1000, 8000}) {
+                ProgramShape shape;
+                shape.procedures = procedures;
+                shape.variable_prefix = prefix;
+                const std::string code = generate_program(shape);
+
+                auto &parser = Parser::instance();
+                parser.initialize_by_raw_code(code);
+                size_t before = allocation_count.load();
+                parser.parse_program();
+                size_t allocations = allocation_count.load() - before;
+
+                fmt_println("{:>12} {:>18} {:>10} {:>14} {:>10.2f}", procedures, prefix + "N", count_lines(code),
+                            allocations, static_cast<double>(allocations) / static_cast<double>(count_lines(code)));
+            }
+        }
+    }
+
+    void bench_load_source() {
+        fmt_println("load_source: reading a generated program from disk");
+        ProgramShape shape;
+        shape.procedures = 160000;
+        shape.variable_prefix = "accumulatedValue";
+        const auto path = std::filesystem::temp_directory_path() / "minispa_load_source.txt";
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << generate_program(shape);
+        }
+        const size_t file_size = std::filesystem::file_size(path);
+
+        // what Parser::initialize_by_file did before SourceBuffer: stream into a stringstream, then copy out
+        long legacy_us = measure_us([] {}, [&] {
+            std::ifstream t(path);
+            std::stringstream buffer;
+            buffer << t.rdbuf();
+            std::string code = buffer.str();
+            Lexer lexer(code);
+        });
+        long mapped_us = measure_us([] {}, [&] {
+            Lexer lexer(SourceBuffer::from_file(path.string()));
+        });
+
+        fmt_println("{:>10} MB   stringstream copy: {:>8} us   mmap: {:>8} us", file_size >> 20, legacy_us, mapped_us);
+        std::filesystem::remove(path);
+    }
+
+    void bench_lex_throughput() {
+        fmt_println("lex_throughput: Lexer over a generated program, per character-scanning implementation");
+        ProgramShape shape;
+        shape.procedures = 20000;
+        shape.variable_prefix = "accumulatedValue";
+        auto source = SourceBuffer::from_string(generate_program(shape));
+        const double megabytes = static_cast<double>(source->view().size()) / (1 << 20);
+
+        const auto detected = lexer_scan::detected_level();
+        for (auto level: {lexer_scan::Level::SCALAR, lexer_scan::Level::SSE2, lexer_scan::Level::AVX2}) {
+            if (static_cast<int>(level) > static_cast<int>(detected)) {
+                continue;
+            }
+            lexer_scan::force_level(level);
+            size_t tokens = 0;
+            long us = measure_us([&] { tokens = 0; }, [&] {
+                Lexer lexer(source);
+                while (lexer.next_token().type != TokenType::END) {
+                    ++tokens;
+                }
+            });
+            fmt_println("{:>8}: {:>8} us  {:>8.1f} MB/s  ({} tokens, {:.1f} MB)", lexer_scan::level_name(level), us,
+                        megabytes / (static_cast<double>(us) / 1e6), tokens, megabytes);
+        }
+        lexer_scan::force_level(detected);
+    }
+
+    // keyword check the Lexer used before simple_keywords: a chain of comparisons on the token's view
+    TokenType classify_with_chain(std::string_view value) {
+        if (value == "procedure") return TokenType::PROCEDURE;
+        if (value == "while") return TokenType::WHILE;
+        if (value == "call") return TokenType::CALL;
+        if (value == "if") return TokenType::IF;
+        if (value == "then") return TokenType::THEN;
+        if (value == "else") return TokenType::ELSE;
+        return TokenType::NAME;
+    }
+
+    void bench_keyword_lookup() {
+        fmt_println("keyword_lookup: classifying every identifier of a generated program");
+        ProgramShape shape;
+        shape.procedures = 4000;
+        auto source = SourceBuffer::from_string(generate_program(shape));
+
+        std::vector<std::string_view> words;
+        Lexer lexer(source);
+        for (Token token = lexer.next_token(); token.type != TokenType::END; token = lexer.next_token()) {
+            if (!token.value.empty() && isalpha(static_cast<unsigned char>(token.value[0]))) {
+                words.push_back(token.value);
+            }
+        }
+
+        // the classifier is inlined into the loop, as it is into Lexer::next_token
+        auto run = [&](const char *name, auto classify) {
+            size_t keywords = 0;
+            long us = measure_us([&] { keywords = 0; }, [&] {
+                for (int repeat = 0; repeat < 10; ++repeat) {
+                    for (auto word: words) {
+                        keywords += classify(word) != TokenType::NAME;
+                    }
+                }
+            });
+            fmt_println("{:>14}: {:>8} us  {:>6.2f} ns/identifier  ({} keywords)", name, us,
+                        static_cast<double>(us) * 1000.0 / static_cast<double>(words.size() * 10), keywords);
+        };
+        run("compare chain", [](std::string_view word) { return classify_with_chain(word); });
+        run("length switch", [](std::string_view word) { return simple_keywords::classify(word); });
+    }
+
+    // hash of the parsed program's structure, name ids and line numbers, to check that parse modes agree
+    size_t ast_fingerprint(const Node *node) {
+        size_t hash = std::hash<std::string>{}(get_node_type(const_cast<Node *>(node))) ^ (node->mLineNumber * 31);
+        auto mix = [&hash](size_t value) { hash = hash * 1099511628211ULL ^ value; };
+        auto mix_list = [&mix](const NodeList &list) {
+            for (const Node *stmt: list) mix(ast_fingerprint(stmt));
+        };
+        if (auto p = node_cast<Procedure>(node)) {
+            mix(p->name);
+            mix_list(p->stmt_list);
+        } else if (auto w = node_cast<WhileStmt>(node)) {
+            mix(w->var_name);
+            mix_list(w->stmt_list);
+        } else if (auto i = node_cast<IfStmt>(node)) {
+            mix(i->var_name);
+            mix_list(i->then_stmt_list);
+            mix_list(i->else_stmt_list);
+        } else if (auto a = node_cast<Assign>(node)) {
+            mix(a->var_name);
+            mix(ast_fingerprint(a->expr));
+        } else if (auto e = node_cast<Expr>(node)) {
+            mix(static_cast<size_t>(e->op));
+            mix(ast_fingerprint(e->left));
+            mix(ast_fingerprint(e->right));
+        } else if (auto f = node_cast<Factor>(node)) {
+            mix(f->value);
+        } else if (auto c = node_cast<Call>(node)) {
+            mix(c->proc_name);
+            mix(c->procedure ? c->procedure->mLineNumber : 0);
+        }
+        return hash;
+    }
+
+    size_t program_fingerprint() {
+        size_t hash = 0;
+        for (const auto &[name, procedure]: Parser::instance().get_all_procedures()) {
+            hash = hash * 31 + ast_fingerprint(procedure);
+        }
+        return hash;
+    }
+
+    void bench_parallel_parse() {
+        fmt_println("parallel_parse: Parser::parse_program time vs thread count ({} cores)",
+                    ThreadPool::resolve_thread_count(0));
+        ProgramShape shape;
+        shape.procedures = 16000;
+        const std::string code = generate_program(shape);
+        auto &parser = Parser::instance();
+
+        size_t expected = 0;
+        long sequential_us = 0;
+        fmt_println("{:>8} {:>12} {:>9} {:>8}", "threads", "parse [us]", "speedup", "same AST");
+        // a few oversubscribed runs are kept on small machines to check that the result does not depend on threads
+        const size_t max_threads = std::max<size_t>(ThreadPool::resolve_thread_count(0), 4);
+        for (size_t threads: {1, 2, 4, 8, 16, 32}) {
+            if (threads > max_threads) {
+                break;
+            }
+            parser.set_parse_threads(threads);
+            long us = measure_us([&] { parser.initialize_by_raw_code(code); }, [&] { parser.parse_program(); });
+            size_t fingerprint = program_fingerprint();
+            if (threads == 1) {
+                expected = fingerprint;
+                sequential_us = us;
+            }
+            fmt_println("{:>8} {:>12} {:>9.2f} {:>8}", threads, us,
+                        static_cast<double>(sequential_us) / static_cast<double>(us), fingerprint == expected);
+        }
+        parser.set_parse_threads(1);
+    }
+
+    void bench_ast_footprint() {
+        fmt_println("ast_footprint: parse throughput and heap held by the parsed program (single thread)");
+        fmt_println("{:>12} {:>10} {:>12} {:>10} {:>14} {:>12} {:>14}", "procedures", "lines", "parse [us]", "MB/s",
+                    "allocations", "AST [KB]", "AST bytes/line");
+        auto &parser = Parser::instance();
+        parser.set_parse_threads(1);
+        for (size_t procedures: {1000, 8000}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            const std::string code = generate_program(shape);
+
+            long us = measure_us([&] { parser.initialize_by_raw_code(code); }, [&] { parser.parse_program(); });
+
+            parser.initialize_by_raw_code(code);
+            size_t allocations_before = allocation_count.load();
+            size_t live_before = live_heap_bytes.load();
+            parser.parse_program();
+            size_t allocations = allocation_count.load() - allocations_before;
+            size_t ast_bytes = live_heap_bytes.load() - live_before;
+
+            fmt_println("{:>12} {:>10} {:>12} {:>10.1f} {:>14} {:>12} {:>14.1f}", procedures, count_lines(code), us,
+                        static_cast<double>(code.size()) / static_cast<double>(us), allocations, ast_bytes >> 10,
+                        static_cast<double>(ast_bytes) / static_cast<double>(count_lines(code)));
+        }
+        parser.set_parse_threads(1);
+    }
+
+    // growth of the resident set high-water mark while body runs, -1 where /proc/self/clear_refs is unavailable
+    long peak_rss_growth_kb(const std::function<void()> &body) {
+        auto read_kb = [](const std::string &field) {
+            std::ifstream status("/proc/self/status");
+            std::string line;
+            while (std::getline(status, line)) {
+                if (line.rfind(field, 0) == 0) {
+                    return std::stol(line.substr(field.size()));
+                }
+            }
+            return -1L;
+        };
+        {
+            std::ofstream clear_refs("/proc/self/clear_refs");
+            clear_refs << "5"; // resets VmHWM to the current RSS
+            if (!clear_refs) {
+                body();
+                return -1;
+            }
+        }
+        long before = read_kb("VmRSS:");
+        body();
+        long peak = read_kb("VmHWM:");
+        return before < 0 || peak < 0 ? -1 : peak - before;
+    }
+
+    size_t lex_all(Lexer &lexer) {
+        size_t tokens = 0;
+        while (lexer.next_token().type != TokenType::END) {
+            tokens++;
+        }
+        return tokens;
+    }
+
+    void bench_stream_source() {
+        fmt_println("stream_source: lexing a file held in memory vs streamed in chunks");
+        ProgramShape shape;
+        shape.procedures = 160000;
+        shape.variable_prefix = "accumulatedValue";
+        const auto path = std::filesystem::temp_directory_path() / "minispa_stream_source.txt";
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << generate_program(shape);
+        }
+        const size_t file_size = std::filesystem::file_size(path);
+        const double megabytes = static_cast<double>(file_size) / (1 << 20);
+
+        fmt_println("{:>24} {:>10} {:>8} {:>14} {:>18}", "mode", "lex [us]", "MB/s", "source [KB]",
+                    "peak RSS growth [KB]");
+        long us = measure_us([] {}, [&] {
+            Lexer lexer(SourceBuffer::from_file(path.string()));
+            lex_all(lexer);
+        });
+        long rss = peak_rss_growth_kb([&] {
+            Lexer lexer(SourceBuffer::from_file(path.string()));
+            lex_all(lexer);
+        });
+        fmt_println("{:>24} {:>10} {:>8.1f} {:>14} {:>18}", "whole file (mmap)", us,
+                    megabytes / (static_cast<double>(us) / 1e6), file_size >> 10, rss);
+
+        for (size_t chunk: {size_t(1) << 12, size_t(1) << 16, size_t(1) << 20}) {
+            size_t window = 0;
+            us = measure_us([] {}, [&] {
+                Lexer lexer(SourceStream::open(path.string(), chunk));
+                lex_all(lexer);
+                window = lexer.get_peak_window();
+            });
+            rss = peak_rss_growth_kb([&] {
+                Lexer lexer(SourceStream::open(path.string(), chunk));
+                lex_all(lexer);
+            });
+            fmt_println("{:>24} {:>10} {:>8.1f} {:>14} {:>18}", "stream " + std::to_string(chunk >> 10) + " KB chunks",
+                        us, megabytes / (static_cast<double>(us) / 1e6), window >> 10, rss);
+        }
+        std::filesystem::remove(path);
+
+        // tiny chunks split nearly every token, the AST must not change
+        shape.procedures = 200;
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << generate_program(shape);
+        }
+        auto &parser = Parser::instance();
+        parser.initialize_by_file(path.string());
+        parser.parse_program();
+        const size_t expected = program_fingerprint();
+        for (size_t chunk: {1, 3, 7, 64, 4096}) {
+            parser.initialize_by_stream(path.string(), chunk);
+            parser.parse_program();
+            fmt_println("{:>24} same AST: {}", "stream " + std::to_string(chunk) + " B chunks",
+                        program_fingerprint() == expected);
+        }
+        std::filesystem::remove(path);
+    }
+
+    // every procedure calls the next one, so walks from a procedure cover the rest of the program
+    void bench_tree_traversal() {
+        fmt_println("tree_traversal: walks over the PKB tree (PKB::build_AST, no relation extraction)");
+        fmt_println("{:>12} {:>8} {:>12} {:>16} {:>12} {:>12}", "procedures", "tnodes", "visited",
+                    "ast_as_list [us]", "parentT [us]", "followsT [us]");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {100, 400}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+            PKB::instance().build_AST();
+            const auto roots = PKB::instance().get_root_nodes();
+
+            size_t visited = 0;
+            long list_us = measure_us([] {}, [&] {
+                visited = 0;
+                for (const auto &root: roots) {
+                    visited += PKB::get_ast_as_list(root).size();
+                }
+            });
+            const size_t tnodes = PKB::get_ast_as_list(roots.front()).size();
+
+            // the last node of the program is below every procedure, so each check walks the whole reachable tree
+            const auto deepest = PKB::get_ast_as_list(roots.front()).back();
+            size_t found = 0;
+            long parent_us = measure_us([] {}, [&] {
+                found = 0;
+                for (const auto &root: roots) {
+                    found += PKB::parentT(root, deepest);
+                }
+            });
+
+            long follows_us = measure_us([] {}, [&] {
+                for (int repeat = 0; repeat < 1000; ++repeat) {
+                    for (const auto &root: roots) {
+                        auto first = root.get_first_child();
+                        auto last = first;
+                        while (last.get_right_sibling()) {
+                            last = last.get_right_sibling();
+                        }
+                        found += PKB::followsT(first, last);
+                    }
+                }
+            });
+
+            fmt_println("{:>12} {:>8} {:>12} {:>16} {:>12} {:>12}", procedures, tnodes, visited, list_us, parent_us,
+                        follows_us);
+        }
+    }
+
+    // subtree walks from every while and if in stmt# order: Parent* from the statement, Modifies and Uses of a
+    // variable none of them touch, so each call scans the statement's whole subtree
+    void bench_subtree_scans() {
+        fmt_println("subtree_scans: Parent*/Modifies/Uses subtree walks over the TNode table (PKB::build_AST)");
+        fmt_println("{:>12} {:>10} {:>10} {:>12} {:>14} {:>14} {:>14}", "procedures", "tnodes", "scans",
+                    "walks [us]", "cache misses", "misses/scan", "far jumps/scan");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {1000, 4000, 16000}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            shape.blocks_per_procedure = 8;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+            PKB::instance().build_AST();
+            auto &pkb = PKB::instance();
+
+            std::vector<TNode> containers;
+            for (size_t n = 1; n <= pkb.get_stmt_count(); ++n) {
+                if (pkb.get_stmt_type(n) == TN_WHILE || pkb.get_stmt_type(n) == TN_IF) {
+                    containers.push_back(pkb.get_stmt(n));
+                }
+            }
+            // the condition variable of the first container is a factor row no other statement reaches
+            const TNode missing = containers.front().get_first_child();
+
+            size_t found = 0;
+            long long misses = -1;
+            long walks_us = measure_us([] {}, [&] {
+                CacheMisses counter;
+                found = 0;
+                for (const TNode container: containers) {
+                    found += PKB::parentT(container, missing);
+                    found += PKB::modifies(container, missing);
+                    found += PKB::uses(container, missing);
+                }
+                misses = counter.count();
+            });
+
+            // machine independent view of the same walks: steps from one visited row to the next, within a scan and
+            // from one scan to the next, further apart than a cache line of a link column
+            constexpr TNodeId LINE_ROWS = 64 / sizeof(TNodeId);
+            size_t far_jumps = 0;
+            TNodeId from = 0;
+            for (const TNode container: containers) {
+                for (const TNode row: PKB::get_ast_as_list(container)) {
+                    TNodeId to = row.get_id();
+                    far_jumps += (from < to ? to - from : from - to) >= LINE_ROWS;
+                    from = to;
+                }
+            }
+
+            const auto scans = static_cast<double>(containers.size());
+            fmt_println("{:>12} {:>10} {:>10} {:>12} {:>14} {:>14} {:>14.2f}", procedures,
+                        TNodeTable::instance().size(), containers.size(), walks_us, format_count(misses),
+                        misses < 0 ? "n/a" : fmt::format("{:.2f}", static_cast<double>(misses) / scans),
+                        static_cast<double>(far_jumps) / scans);
+        }
+    }
+
+    void bench_pkb_initialize() {
+        fmt_println("pkb_initialize: TNode table construction and relation extraction");
+        fmt_println("{:>12} {:>8} {:>16} {:>16} {:>14}", "procedures", "tnodes", "build_AST [us]", "initialize [us]",
+                    "allocations");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {5, 10, 20}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+
+            long build_us = measure_us([] {}, [] { PKB::instance().build_AST(); });
+            size_t allocations = 0;
+            long initialize_us = measure_us([] {}, [&allocations] {
+                size_t before = allocation_count.load();
+                PKB::instance().initialize();
+                allocations = allocation_count.load() - before;
+            }, 1);
+            const size_t tnodes = TNodeTable::instance().size();
+
+            fmt_println("{:>12} {:>8} {:>16} {:>16} {:>14}", procedures, tnodes, build_us, initialize_us, allocations);
+        }
+    }
+
+    void bench_build_ast_calls() {
+        fmt_println("build_ast_calls: PKB::build_AST on call heavy programs (4 calls after every block)");
+        fmt_println("{:>12} {:>8} {:>10} {:>16} {:>12} {:>14}", "procedures", "calls", "tnodes", "build_AST [us]",
+                    "ns/tnode", "allocations");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {250, 500, 1000, 2000}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            shape.calls_per_block = 4;
+            const std::string code = generate_program(shape);
+            size_t calls = 0;
+            for (size_t at = code.find("call "); at != std::string::npos; at = code.find("call ", at + 1)) {
+                ++calls;
+            }
+            parser.initialize_by_raw_code(code);
+            parser.parse_program();
+
+            size_t allocations = 0;
+            long build_us = measure_us([] {}, [&allocations] {
+                size_t before = allocation_count.load();
+                PKB::instance().build_AST();
+                allocations = allocation_count.load() - before;
+            });
+            const size_t tnodes = TNodeTable::instance().size();
+
+            fmt_println("{:>12} {:>8} {:>10} {:>16} {:>12.1f} {:>14}", procedures, calls, tnodes, build_us,
+                        1000.0 * static_cast<double>(build_us) / static_cast<double>(tnodes), allocations);
+        }
+    }
+
+    // every relation pair as text that does not depend on TNode ids or on the order rows were added in,
+    // factors are told apart by name and by the statement they belong to
+    std::vector<std::string> relation_snapshot() {
+        auto describe = [](TNode node) {
+            std::string text = std::to_string(node.get_tnode_type());
+            if (node.get_name() != NameTable::NONE) {
+                text += " " + NameTable::instance().name(node.get_name());
+            }
+            TNode stmt = node;
+            while (stmt && !PKB::is_statement(stmt) && stmt.get_tnode_type() != TN_PROCEDURE) {
+                stmt = stmt.get_parent();
+            }
+            if (stmt && PKB::is_statement(stmt)) {
+                text += " #" + std::to_string(stmt.get_command_no());
+            }
+            return text;
+        };
+        std::vector<std::string> snapshot;
+        int relation = 0;
+        for (const auto &relations: {PKB::parentRelations, PKB::parentTRelations, PKB::followsRelations,
+                                     PKB::followsTRelations, PKB::modifiesRelations, PKB::usesRelations,
+                                     PKB::callsRelations, PKB::callsTRelations, PKB::nextRelations,
+                                     PKB::nextTRelations}) {
+            for (const auto &[left, right]: *relations) {
+                snapshot.push_back(std::to_string(relation) + ": " + describe(left) + " -> " + describe(right));
+            }
+            ++relation;
+        }
+        std::sort(snapshot.begin(), snapshot.end());
+        return snapshot;
+    }
+
+    void bench_incremental_update() {
+        fmt_println("incremental_update: PKB::update_procedure vs reparsing and PKB::initialize from scratch");
+        fmt_println("{:>12} {:>10} {:>10} {:>16} {:>16} {:>10}", "procedures", "edited", "callers", "full [us]",
+                    "incremental [us]", "same");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {10, 20, 40}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            const std::string code = generate_program(shape);
+
+            // procedure k is called by the k before it through the chain: from no caller up to every other procedure
+            for (size_t edited: {size_t{0}, procedures / 4, procedures / 2, 3 * procedures / 4, procedures - 1}) {
+                const std::string name = "P" + std::to_string(edited);
+                std::string body = "procedure " + name + " {\n  w = v1 + v2;\n  while v3 {\n    w = w - 1;\n";
+                if (edited + 1 < procedures) {
+                    body += "    call P" + std::to_string(edited + 1) + ";\n";
+                }
+                body += "    v4 = w; }\n  if w then {\n    v5 = 0; }\n  else {\n    v6 = w + 1; }\n}\n";
+
+                size_t begin = code.find("procedure " + name + " {");
+                size_t end = code.find("procedure ", begin + 1);
+                std::string edited_code = code;
+                edited_code.replace(begin, (end == std::string::npos ? code.size() : end) - begin, body);
+
+                long full_us = measure_us([] {}, [&] {
+                    parser.initialize_by_raw_code(edited_code);
+                    parser.parse_program();
+                    PKB::instance().initialize();
+                });
+                const auto expected = relation_snapshot();
+
+                long incremental_us = measure_us([&] {
+                    parser.initialize_by_raw_code(code);
+                    parser.parse_program();
+                    PKB::instance().initialize();
+                }, [&] { PKB::instance().update_procedure(body); });
+
+                fmt_println("{:>12} {:>10} {:>10} {:>16} {:>16} {:>10}", procedures, name, edited, full_us,
+                            incremental_us, relation_snapshot() == expected ? "yes" : "NO");
+            }
+        }
+
+        // a body that was emptied gets its statements back between those of the procedures around it
+        auto stmt_procedures = [] {
+            std::vector<std::string> procedures;
+            for (size_t stmt_no = 1; PKB::instance().get_stmt(stmt_no); ++stmt_no) {
+                const TNode procedure = PKB::instance().get_stmt_procedure(stmt_no);
+                procedures.push_back(NameTable::instance().name(procedure.get_name()));
+            }
+            return procedures;
+        };
+        const std::string first = "procedure A {\n  a = 1; }\n";
+        const std::string last = "procedure C {\n  c = 1; }\n";
+        const std::string code = first + "procedure B {\n  b = 1; }\n" + last;
+        const std::string emptied = "procedure B {\n}\n";
+        const std::string refilled = "procedure B {\n  b = 2;\n  bb = 3; }\n";
+        long full_us = measure_us([] {}, [&] {
+            parser.initialize_by_raw_code(first + refilled + last);
+            parser.parse_program();
+            PKB::instance().initialize();
+        });
+        const auto expected = relation_snapshot();
+        const auto expected_procedures = stmt_procedures();
+        long incremental_us = measure_us([&] {
+            parser.initialize_by_raw_code(code);
+            parser.parse_program();
+            PKB::instance().initialize();
+            PKB::instance().update_procedure(emptied);
+        }, [&] { PKB::instance().update_procedure(refilled); });
+        fmt_println("{:>12} {:>10} {:>10} {:>16} {:>16} {:>10}", 3, "B emptied", 0, full_us, incremental_us,
+                    relation_snapshot() == expected && stmt_procedures() == expected_procedures ? "yes" : "NO");
+    }
+
+    // every relation vector as it is, TNode ids and order included
+    std::vector<std::vector<std::pair<TNode, TNode>>> relation_vectors() {
+        std::vector<std::vector<std::pair<TNode, TNode>>> vectors;
+        for (const auto &relations: {PKB::parentRelations, PKB::parentTRelations, PKB::followsRelations,
+                                     PKB::followsTRelations, PKB::modifiesRelations, PKB::usesRelations,
+                                     PKB::callsRelations, PKB::callsTRelations, PKB::nextRelations,
+                                     PKB::nextTRelations}) {
+            vectors.push_back(*relations);
+        }
+        return vectors;
+    }
+
+    void bench_fused_extraction() {
+        fmt_println("fused_extraction: parse_program + PKB::initialize, relations searched for vs recorded while parsing");
+        fmt_println("{:>12} {:>8} {:>16} {:>16} {:>16} {:>16} {:>8}", "procedures", "tnodes", "parse [us]",
+                    "initialize [us]", "fused parse [us]", "fused init [us]", "same");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {5, 10, 20}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            const std::string code = generate_program(shape);
+
+            long times[2][2];
+            std::vector<std::vector<std::pair<TNode, TNode>>> relations[2];
+            for (int fused = 0; fused < 2; ++fused) {
+                parser.set_fused_extraction(fused == 1);
+                times[fused][0] = measure_us([&] { parser.initialize_by_raw_code(code); },
+                                             [&] { parser.parse_program(); });
+                times[fused][1] = measure_us([] {}, [] { PKB::instance().initialize(); }, 1);
+                relations[fused] = relation_vectors();
+            }
+            parser.set_fused_extraction(false);
+
+            fmt_println("{:>12} {:>8} {:>16} {:>16} {:>16} {:>16} {:>8}", procedures, TNodeTable::instance().size(),
+                        times[0][0], times[0][1], times[1][0], times[1][1],
+                        relations[0] == relations[1] ? "yes" : "NO");
+        }
+    }
+
+    // procedures that call no other one, so the relation count grows linearly with the program and so should the time
+    void bench_pkb_scaling() {
+        fmt_println("pkb_scaling: PKB::initialize time vs program size (procedures without calls)");
+        fmt_println("{:>12} {:>12} {:>10} {:>12} {:>16} {:>12}", "procedures", "statements", "tnodes", "relations",
+                    "initialize [us]", "ns/relation");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {25, 50, 100, 200, 400}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            shape.call_next = false;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+
+            long initialize_us = measure_us([] {}, [] { PKB::instance().initialize(); }, 1);
+            size_t relations = 0;
+            for (const auto &vector: relation_vectors()) {
+                relations += vector.size();
+            }
+
+            fmt_println("{:>12} {:>12} {:>10} {:>12} {:>16} {:>12.1f}", procedures,
+                        procedures * shape.blocks_per_procedure * 8, TNodeTable::instance().size(), relations,
+                        initialize_us, 1000.0 * static_cast<double>(initialize_us) / static_cast<double>(relations));
+        }
+    }
+
+    void bench_pkb_threads() {
+        fmt_println("pkb_threads: PKB::initialize vs PKB build threads, relations compared with one thread ({} cores)",
+                    ThreadPool::resolve_thread_count(0));
+        fmt_println("{:>12} {:>10} {:>10} {:>16} {:>10} {:>8}", "procedures", "tnodes", "threads", "initialize [us]",
+                    "speedup", "same");
+        auto &parser = Parser::instance();
+        for (size_t procedures: {400, 1600}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            shape.call_next = false;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+
+            long single_us = 0;
+            std::vector<std::vector<std::pair<TNode, TNode>>> expected;
+            for (size_t threads: {1, 2, 4, 8, 16, 32}) {
+                PKB::instance().set_build_threads(threads);
+                long initialize_us = measure_us([] {}, [] { PKB::instance().initialize(); });
+                if (threads == 1) {
+                    single_us = initialize_us;
+                    expected = relation_vectors();
+                }
+                fmt_println("{:>12} {:>10} {:>10} {:>16} {:>10.2f} {:>8}", procedures, TNodeTable::instance().size(),
+                            threads, initialize_us,
+                            static_cast<double>(single_us) / static_cast<double>(initialize_us),
+                            relation_vectors() == expected ? "yes" : "NO");
+            }
+            PKB::instance().set_build_threads(0);
+        }
+    }
+
+    // what handing one step to `threads` threads costs: starting and joining them for the step, as every parallel
+    // step did before the pool, against posting it to a ThreadPool whose threads are already running
+    void bench_pool_dispatch() {
+        const size_t rounds = 2000;
+        fmt_println("pool_dispatch: {} steps of one empty body per thread ({} cores)", rounds,
+                    ThreadPool::resolve_thread_count(0));
+        fmt_println("{:>10} {:>16} {:>16}", "threads", "spawn [us/step]", "pool [us/step]");
+        for (size_t threads: {2, 4, 8, 16}) {
+            std::atomic<size_t> bodies{0};
+            long spawn_us = measure_us([] {}, [&] {
+                for (size_t round = 0; round < rounds; ++round) {
+                    std::vector<std::thread> workers;
+                    for (size_t t = 1; t < threads; ++t) {
+                        workers.emplace_back([&] { ++bodies; });
+                    }
+                    ++bodies;
+                    for (auto &worker: workers) {
+                        worker.join();
+                    }
+                }
+            });
+            ThreadPool pool(threads);
+            long pool_us = measure_us([] {}, [&] {
+                for (size_t round = 0; round < rounds; ++round) {
+                    pool.parallel_for(threads, [&](size_t) { ++bodies; });
+                }
+            });
+            fmt_println("{:>10} {:>16.2f} {:>16.2f}", threads, static_cast<double>(spawn_us) / rounds,
+                        static_cast<double>(pool_us) / rounds);
+        }
+    }
+
+    // procedures of `depth` nested whiles with an assign on every level, Parent* grows with the square of the depth
+    std::string generate_nested_program(size_t procedures, size_t depth) {
+        std::string code;
+        for (size_t p = 0; p < procedures; ++p) {
+            code += "procedure P" + std::to_string(p) + " {\n";
+            for (size_t level = 0; level < depth; ++level) {
+                code += "  v" + std::to_string(level) + " = v" + std::to_string(level + 1) + " + 1;\n";
+                code += "  while w" + std::to_string(level) + " {\n";
+            }
+            code += "  x = y;" + std::string(depth, '}') + "\n}\n";
+        }
+        return code;
+    }
+
+    void bench_parent_star_storage() {
+        fmt_println("parent_star_storage: Parent* stored as pairs vs interval labels only, deeply nested procedures");
+        fmt_println("{:>8} {:>12} {:>14} {:>14} {:>14} {:>16} {:>16} {:>14}", "depth", "statements", "Parent* pairs",
+                    "stored [us]", "labels [us]", "heap [KiB]", "labels heap [KiB]", "parentT [ns]");
+        auto &parser = Parser::instance();
+        auto &pkb = PKB::instance();
+        for (size_t depth: {4, 16, 64, 256}) {
+            parser.initialize_by_raw_code(generate_nested_program(50, depth));
+            parser.parse_program();
+
+            long times[2];
+            size_t heap[2];
+            for (int stored = 1; stored >= 0; --stored) {
+                pkb.set_parent_star_materialized(stored == 1);
+                PKB::instance().initialize(); // the relations of the previous program are freed first
+                times[stored] = measure_us([] {}, [] { PKB::instance().initialize(); }, 1);
+                heap[stored] = live_heap_bytes.load(); // the parsed program and the PKB
+            }
+            const size_t pairs = pkb.get_parent_star_size();
+
+            // every statement against every container of the first procedure
+            std::vector<TNode> stmts;
+            std::vector<TNode> containers;
+            for (size_t n = 1; n <= pkb.get_stmt_count() && pkb.get_stmt_procedure(n) == pkb.get_stmt_procedure(1);
+                 ++n) {
+                stmts.push_back(pkb.get_stmt(n));
+                if (pkb.get_stmt_type(n) == TN_WHILE) {
+                    containers.push_back(pkb.get_stmt(n));
+                }
+            }
+            size_t found = 0;
+            constexpr int REPEATS = 100;
+            long check_us = measure_us([] {}, [&] {
+                for (int repeat = 0; repeat < REPEATS; ++repeat) {
+                    for (const TNode container: containers) {
+                        for (const TNode stmt: stmts) {
+                            found += PKB::parentT(container, stmt);
+                        }
+                    }
+                }
+            });
+            pkb.set_parent_star_materialized(true);
+
+            fmt_println("{:>8} {:>12} {:>14} {:>14} {:>14} {:>16} {:>16} {:>14.1f}", depth, pkb.get_stmt_count(),
+                        pairs, times[1], times[0], heap[1] / 1024, heap[0] / 1024,
+                        1000.0 * static_cast<double>(check_us) /
+                        static_cast<double>(REPEATS * std::max<size_t>(1, containers.size() * stmts.size())));
+        }
+    }
+
+    // procedures of one long statement list, Follows* grows with the square of its length
+    std::string generate_flat_program(size_t procedures, size_t length) {
+        std::string code;
+        for (size_t p = 0; p < procedures; ++p) {
+            code += "procedure P" + std::to_string(p) + " {\n";
+            for (size_t i = 0; i < length; ++i) {
+                code += "  v" + std::to_string(i % 64) + " = v" + std::to_string((i + 1) % 64) + " + 1;\n";
+            }
+            code += "}\n";
+        }
+        return code;
+    }
+
+    void bench_follows_star_storage() {
+        fmt_println("follows_star_storage: Follows* stored as pairs vs list slices only, long statement lists");
+        fmt_println("{:>8} {:>12} {:>14} {:>14} {:>14} {:>12} {:>18} {:>14} {:>16}", "length", "statements",
+                    "Follows* pairs", "stored [us]", "slices [us]", "heap [KiB]", "slices heap [KiB]",
+                    "followsT [ns]", "followers [ns]");
+        auto &parser = Parser::instance();
+        auto &pkb = PKB::instance();
+        for (size_t length: {64, 256, 1024, 4096}) {
+            parser.initialize_by_raw_code(generate_flat_program(8, length));
+            parser.parse_program();
+
+            long times[2];
+            size_t heap[2];
+            for (int stored = 1; stored >= 0; --stored) {
+                pkb.set_follows_star_materialized(stored == 1);
+                PKB::instance().initialize(); // the relations of the previous program are freed first
+                times[stored] = measure_us([] {}, [] { PKB::instance().initialize(); }, 1);
+                heap[stored] = live_heap_bytes.load(); // the parsed program and the PKB
+            }
+            const size_t pairs = pkb.get_follows_star_size();
+
+            // every pair of statements of the first procedure, and the followers of each of them
+            std::vector<TNode> stmts;
+            for (size_t n = 1; n <= length; ++n) {
+                stmts.push_back(pkb.get_stmt(n));
+            }
+            size_t found = 0;
+            long check_us = measure_us([] {}, [&] {
+                for (const TNode first: stmts) {
+                    for (const TNode second: stmts) {
+                        found += PKB::followsT(first, second);
+                    }
+                }
+            });
+            long followers_us = measure_us([] {}, [&] {
+                for (const TNode first: stmts) {
+                    for (const TNode follower: pkb.get_followers(first)) {
+                        found += follower.get_id() & 1;
+                    }
+                }
+            });
+            pkb.set_follows_star_materialized(true);
+
+            const auto checks = static_cast<double>(stmts.size() * stmts.size());
+            const auto followers = static_cast<double>(stmts.size() * (stmts.size() - 1) / 2);
+            fmt_println("{:>8} {:>12} {:>14} {:>14} {:>14} {:>12} {:>18} {:>14.1f} {:>16.2f}", length,
+                        pkb.get_stmt_count(), pairs, times[1], times[0], heap[1] / 1024, heap[0] / 1024,
+                        1000.0 * static_cast<double>(check_us) / checks,
+                        1000.0 * static_cast<double>(followers_us) / followers);
+        }
+    }
+
+    // clauses with a stmt# literal on one side, as in Follows(12, s): answered from the pairs the literal's node is
+    // in, what scanning the whole relation vector for them took before is shown next to it
+    void bench_literal_clauses() {
+        fmt_println("literal_clauses: query clauses with a stmt# literal, per clause (procedures without calls)");
+        fmt_println("{:>12} {:>10} {:>10} {:>12} {:>16} {:>14} {:>14} {:>8}", "procedures", "relation", "side",
+                    "pairs", "first [us]", "clause [us]", "scan [us]", "same");
+        auto &parser = Parser::instance();
+        auto &pkb = PKB::instance();
+        for (size_t procedures: {1000, 4000, 16000}) {
+            ProgramShape shape;
+            shape.procedures = procedures;
+            shape.call_next = false;
+            parser.initialize_by_raw_code(generate_program(shape));
+            parser.parse_program();
+            pkb.initialize();
+
+            std::mt19937 random(3);
+            std::uniform_int_distribution<size_t> any_stmt(1, pkb.get_stmt_count());
+            std::vector<size_t> literals(200);
+            for (size_t &literal: literals) {
+                literal = any_stmt(random);
+            }
+            for (const auto &[relation, relations]: std::vector<std::pair<std::string,
+                    std::shared_ptr<std::vector<std::pair<TNode, TNode>>>>>{
+                    {"Follows", PKB::followsRelations}, {"Parent*", PKB::parentTRelations},
+                    {"Uses", PKB::usesRelations}, {"Next*", PKB::nextTRelations}}) {
+                for (const bool left: {true, false}) {
+                    if (!left && relation == "Uses") {
+                        continue; // the right side of Uses is a variable
+                    }
+                    size_t answers = 0;
+                    auto run_clause = [&, relation = relation](size_t literal) {
+                        const std::string stmt_no = std::to_string(literal);
+                        query::Instruction instruction({"s"});
+                        instruction.variable_types["s"] = "stmt";
+                        instruction.add_sub_instruction(left ? query::SubInstruction(relation, stmt_no, "s")
+                                                             : query::SubInstruction(relation, "s", stmt_no));
+                        instruction.process_query();
+                        answers += instruction.variable_result.size();
+                    };
+                    // the first clause with a literal on this side indexes the pairs of the relation by it
+                    long first_us = measure_us([] {}, [&] { run_clause(literals.front()); }, 1);
+                    long clause_us = measure_us([&] { answers = 0; }, [&] {
+                        for (size_t literal: literals) {
+                            run_clause(literal);
+                        }
+                    });
+                    size_t scanned = 0;
+                    long scan_us = measure_us([&] { scanned = 0; }, [&] {
+                        for (size_t literal: literals) {
+                            const TNode node = pkb.get_stmt(literal);
+                            for (const auto &[first, second]: *relations) {
+                                scanned += (left ? first : second) == node;
+                            }
+                        }
+                    });
+                    fmt_println("{:>12} {:>10} {:>10} {:>12} {:>16} {:>14.2f} {:>14.2f} {:>8}", procedures, relation,
+                                left ? "left" : "right", relations->size(), first_us,
+                                static_cast<double>(clause_us) / static_cast<double>(literals.size()),
+                                static_cast<double>(scan_us) / static_cast<double>(literals.size()),
+                                answers == scanned ? "yes" : "NO");
+                }
+            }
+        }
+    }
+
+    // random call graph: every procedure calls 4 later ones, and every 50th calls back a few procedures, so there
+    // are cycles of recursive procedures too
+    CallGraph generate_call_graph(size_t procedures) {
+        std::mt19937 random(42);
+        CallGraph graph;
+        graph.reset(procedures);
+        for (size_t p = 0; p < procedures; ++p) {
+            for (int c = 0; c < 4 && p + 1 < procedures; ++c) {
+                std::uniform_int_distribution<size_t> later(p + 1, std::min(procedures - 1, p + 200));
+                graph.add_call(static_cast<CallGraph::Vertex>(p), static_cast<CallGraph::Vertex>(later(random)));
+            }
+            if (p % 50 == 49) {
+                graph.add_call(static_cast<CallGraph::Vertex>(p), static_cast<CallGraph::Vertex>(p - 3));
+            }
+        }
+        graph.finalize();
+        return graph;
+    }
+
+    // Calls* by searching the graph, what the closure replaces
+    bool reaches_by_search(const CallGraph &graph, CallGraph::Vertex from, CallGraph::Vertex to) {
+        std::vector<char> seen(graph.size(), 0);
+        std::vector<CallGraph::Vertex> pending{from};
+        while (!pending.empty()) {
+            const CallGraph::Vertex procedure = pending.back();
+            pending.pop_back();
+            for (CallGraph::Vertex callee: graph.callees(procedure)) {
+                if (callee == to) {
+                    return true;
+                }
+                if (!seen[callee]) {
+                    seen[callee] = 1;
+                    pending.push_back(callee);
+                }
+            }
+        }
+        return false;
+    }
+
+    void bench_calls_closure() {
+        fmt_println("calls_closure: Calls* as a bit matrix over procedures (SCCs, rows ORed callees first) vs search");
+        fmt_println("{:>12} {:>12} {:>14} {:>14} {:>16} {:>14} {:>14} {:>8}", "procedures", "components",
+                    "finalize [us]", "matrix [KiB]", "lookup [ns]", "search [ns]", "row scan [ns]", "same");
+        for (size_t procedures: {1000, 4000, 16000}) {
+            CallGraph graph;
+            long finalize_us = measure_us([] {}, [&] { graph = generate_call_graph(procedures); }, 1);
+
+            std::mt19937 random(7);
+            std::uniform_int_distribution<CallGraph::Vertex> any(0, static_cast<CallGraph::Vertex>(procedures - 1));
+            std::vector<std::pair<CallGraph::Vertex, CallGraph::Vertex>> queries(1000000);
+            for (auto &[from, to]: queries) {
+                from = any(random);
+                to = any(random);
+            }
+            size_t found = 0;
+            long lookup_us = measure_us([] {}, [&] {
+                for (const auto &[from, to]: queries) {
+                    found += graph.reaches(from, to);
+                }
+            });
+            constexpr size_t SEARCHES = 2000;
+            bool same = true;
+            long search_us = measure_us([] {}, [&] {
+                for (size_t q = 0; q < SEARCHES; ++q) {
+                    const bool reached = reaches_by_search(graph, queries[q].first, queries[q].second);
+                    same = same && reached == graph.reaches(queries[q].first, queries[q].second);
+                }
+            }, 1);
+            size_t reached = 0;
+            long scan_us = measure_us([] {}, [&] {
+                reached = 0;
+                for (CallGraph::Vertex p = 0; p < procedures; ++p) {
+                    graph.for_each_reached(p, [&reached](CallGraph::Vertex) { ++reached; });
+                }
+            });
+
+            fmt_println("{:>12} {:>12} {:>14} {:>14} {:>16.1f} {:>14.1f} {:>14.2f} {:>8}", procedures,
+                        graph.component_count(), finalize_us,
+                        graph.component_count() * graph.closure_words() * sizeof(uint64_t) / 1024,
+                        1000.0 * static_cast<double>(lookup_us) / static_cast<double>(queries.size()),
+                        1000.0 * static_cast<double>(search_us) / SEARCHES,
+                        1000.0 * static_cast<double>(scan_us) / static_cast<double>(std::max<size_t>(1, reached)),
+                        same ? "yes" : "NO");
+        }
+    }
+
+    const std::vector<std::pair<std::string, std::function<void()>>> scenarios = {
+            {"parse_scaling",     bench_parse_scaling},
+            {"parse_allocations", bench_parse_allocations},
+            {"load_source",       bench_load_source},
+            {"lex_throughput",    bench_lex_throughput},
+            {"keyword_lookup",    bench_keyword_lookup},
+            {"parallel_parse",    bench_parallel_parse},
+            {"ast_footprint",     bench_ast_footprint},
+            {"stream_source",     bench_stream_source},
+            {"tree_traversal",    bench_tree_traversal},
+            {"subtree_scans",     bench_subtree_scans},
+            {"pkb_initialize",    bench_pkb_initialize},
+            {"build_ast_calls",   bench_build_ast_calls},
+            {"incremental_update", bench_incremental_update},
+            {"fused_extraction",  bench_fused_extraction},
+            {"pkb_scaling",       bench_pkb_scaling},
+            {"pkb_threads",       bench_pkb_threads},
+            {"pool_dispatch",     bench_pool_dispatch},
+            {"parent_star_storage", bench_parent_star_storage},
+            {"follows_star_storage", bench_follows_star_storage},
+            {"literal_clauses",   bench_literal_clauses},
+            {"calls_closure",     bench_calls_closure},
+    };
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> selected(argv + 1, argv + argc);
+
+    for (const auto &[name, run]: scenarios) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), name) != selected.end()) {
+            run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "call_graph.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "thread_pool.h"
+
+void CallGraph::reset(size_t vertices) {
+    callee_lists.assign(vertices, {});
+    caller_lists.assign(vertices, {});
+    components.assign(vertices, NONE);
+    recursive_flags.assign(vertices, 0);
+    order.clear();
+    component_total = 0;
+    closure.clear();
+    words = 0;
+}
+
+void CallGraph::add_call(Vertex caller, Vertex callee) {
+    auto &callees = callee_lists[caller];
+    if (std::find(callees.begin(), callees.end(), callee) == callees.end()) {
+        callees.push_back(callee);
+        caller_lists[callee].push_back(caller);
+    }
+}
+
+void CallGraph::set_callees(Vertex caller, const std::vector<Vertex> &callees) {
+    for (Vertex callee: callee_lists[caller]) {
+        auto &callers = caller_lists[callee];
+        callers.erase(std::find(callers.begin(), callers.end(), caller));
+    }
+    callee_lists[caller].clear();
+    for (Vertex callee: callees) {
+        auto &list = callee_lists[caller];
+        if (std::find(list.begin(), list.end(), callee) == list.end()) {
+            list.push_back(callee);
+            // callers stay in vertex order, as reset() and add_call() in vertex order leave them
+            auto &callers = caller_lists[callee];
+            callers.insert(std::lower_bound(callers.begin(), callers.end(), caller), caller);
+        }
+    }
+}
+
+void CallGraph::finalize() {
+    ThreadPool caller_only(1);
+    finalize(caller_only);
+}
+
+// Tarjan's algorithm with an explicit stack, call chains can be as deep as the program is long
+void CallGraph::finalize(ThreadPool &pool) {
+    const size_t vertices = size();
+    std::vector<Vertex> index(vertices, NONE);
+    std::vector<Vertex> low(vertices, 0);
+    std::vector<char> on_stack(vertices, 0);
+    std::vector<Vertex> stack;
+    std::vector<std::pair<Vertex, size_t>> frames; // vertex being visited and its next callee
+    Vertex next_index = 0;
+    order.clear();
+    component_total = 0;
+
+    auto visit = [&](Vertex procedure) {
+        index[procedure] = low[procedure] = next_index++;
+        stack.push_back(procedure);
+        on_stack[procedure] = 1;
+        frames.emplace_back(procedure, 0);
+    };
+
+    for (Vertex root = 0; root < vertices; ++root) {
+        if (index[root] != NONE) {
+            continue;
+        }
+        visit(root);
+        while (!frames.empty()) {
+            const Vertex procedure = frames.back().first;
+            const size_t edge = frames.back().second;
+            if (edge < callee_lists[procedure].size()) {
+                frames.back().second = edge + 1;
+                const Vertex callee = callee_lists[procedure][edge];
+                if (index[callee] == NONE) {
+                    visit(callee);
+                } else if (on_stack[callee]) {
+                    low[procedure] = std::min(low[procedure], index[callee]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                const Vertex caller = frames.back().first;
+                low[caller] = std::min(low[caller], low[procedure]);
+            }
+            if (low[procedure] != index[procedure]) {
+                continue;
+            }
+            // procedure is the root of a component, everything above it on the stack belongs to it
+            const size_t first = order.size();
+            Vertex member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member] = 0;
+                components[member] = static_cast<Vertex>(component_total);
+                order.push_back(member);
+            } while (member != procedure);
+            const bool cycle = order.size() - first > 1 ||
+                               std::find(callee_lists[procedure].begin(), callee_lists[procedure].end(), procedure) !=
+                               callee_lists[procedure].end();
+            for (size_t i = first; i < order.size(); ++i) {
+                recursive_flags[order[i]] = cycle;
+            }
+            ++component_total;
+        }
+    }
+    compute_closure(pool);
+}
+
+// components are numbered callees first, so the rows a component ORs in are complete when it is reached.
+// A component calls its members only when it is a cycle, then every member reaches every other one.
+// The rows of a level, components whose longest chain of calls into other components is as long, only read rows of
+// lower levels, so each level is handed out on the pool
+void CallGraph::compute_closure(ThreadPool &pool) {
+    const size_t vertices = size();
+    words = (vertices + 63) / 64;
+    closure.assign(component_total * words, 0);
+    // order lists the members of each component together, components ascending
+    std::vector<size_t> member_begin(component_total + 1, 0);
+    for (Vertex procedure = 0; procedure < vertices; ++procedure) {
+        ++member_begin[components[procedure] + 1];
+    }
+    std::partial_sum(member_begin.begin(), member_begin.end(), member_begin.begin());
+
+    std::vector<size_t> level(component_total, 0);
+    std::vector<std::vector<Vertex>> levels;
+    for (size_t component = 0; component < component_total; ++component) {
+        for (size_t i = member_begin[component]; i < member_begin[component + 1]; ++i) {
+            for (Vertex callee: callee_lists[order[i]]) {
+                if (components[callee] != component) {
+                    level[component] = std::max(level[component], level[components[callee]] + 1);
+                }
+            }
+        }
+        if (level[component] == levels.size()) {
+            levels.emplace_back();
+        }
+        levels[level[component]].push_back(static_cast<Vertex>(component));
+    }
+
+    auto compute_row = [&](const size_t component) {
+        uint64_t *row = closure.data() + component * words;
+        for (size_t i = member_begin[component]; i < member_begin[component + 1]; ++i) {
+            const Vertex member = order[i];
+            if (recursive_flags[member]) {
+                row[member / 64] |= uint64_t{1} << (member % 64);
+            }
+            for (Vertex callee: callee_lists[member]) {
+                row[callee / 64] |= uint64_t{1} << (callee % 64);
+                if (components[callee] != component) {
+                    const uint64_t *reached = closure.data() + components[callee] * words;
+                    for (size_t w = 0; w < words; ++w) {
+                        row[w] |= reached[w];
+                    }
+                }
+            }
+        }
+    };
+    for (const auto &components_of_level: levels) {
+        pool.parallel_for(components_of_level.size(), [&](size_t i) {
+            compute_row(components_of_level[i]);
+        });
+    }
+}
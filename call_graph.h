@@ -0,0 +1,132 @@
+#ifndef MINISPA_CALL_GRAPH_H
+#define MINISPA_CALL_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+class ThreadPool;
+
+// Procedures and the calls between them, procedures are vertices numbered from 0.
+// finalize() condenses the graph into strongly connected components (Tarjan), so cycles of
+// recursive procedures are one component and the components form a DAG, then computes the transitive
+// closure (Calls*) as one row of bits per component over all procedures.
+class CallGraph {
+public:
+    using Vertex = uint32_t;
+
+    static constexpr Vertex NONE = UINT32_MAX;
+
+    // drops every call and leaves `vertices` procedures
+    void reset(size_t vertices);
+
+    // a procedure calling another more than once is one edge
+    void add_call(Vertex caller, Vertex callee);
+
+    // replaces the calls of caller with one to each of callees, in that order; finalize() has to be called again
+    void set_callees(Vertex caller, const std::vector<Vertex> &callees);
+
+    // computes the components and the order, has to be called after the last add_call
+    void finalize();
+
+    // finalize with the closure computed on the threads of pool
+    void finalize(ThreadPool &pool);
+
+    [[nodiscard]] size_t size() const {
+        return callee_lists.size();
+    }
+
+    // procedures called directly, in the order they are first called
+    [[nodiscard]] const std::vector<Vertex> &callees(Vertex procedure) const {
+        return callee_lists[procedure];
+    }
+
+    [[nodiscard]] const std::vector<Vertex> &callers(Vertex procedure) const {
+        return caller_lists[procedure];
+    }
+
+    // components are numbered in reverse topological order: a component only calls into lower numbered
+    // ones and itself
+    [[nodiscard]] Vertex component(Vertex procedure) const {
+        return components[procedure];
+    }
+
+    [[nodiscard]] size_t component_count() const {
+        return component_total;
+    }
+
+    // procedure calls itself, directly or through other procedures
+    [[nodiscard]] bool recursive(Vertex procedure) const {
+        return recursive_flags[procedure];
+    }
+
+    // every procedure, callees before their callers (procedures of one component are next to each other)
+    [[nodiscard]] const std::vector<Vertex> &reverse_topological_order() const {
+        return order;
+    }
+
+    // from calls to, directly or through other procedures (Calls*)
+    [[nodiscard]] bool reaches(Vertex from, Vertex to) const {
+        return (closure_row(from)[to / 64] >> (to % 64)) & 1;
+    }
+
+    // words of a closure row, bit p of the row of a procedure is set when it calls p, directly or not
+    [[nodiscard]] size_t closure_words() const {
+        return words;
+    }
+
+    [[nodiscard]] const uint64_t *closure_row(Vertex procedure) const {
+        return closure.data() + components[procedure] * words;
+    }
+
+    // sets the bits of the procedures `from` calls, directly or not, in a row of closure_words() words
+    void add_reached(Vertex from, uint64_t *row) const {
+        const uint64_t *reached = closure_row(from);
+        for (size_t w = 0; w < words; ++w) {
+            row[w] |= reached[w];
+        }
+    }
+
+    // f(procedure) for every procedure `from` calls, directly or not, in vertex order
+    template<typename F>
+    void for_each_reached(Vertex from, F f) const {
+        for_each_set(closure_row(from), f);
+    }
+
+    // f(procedure) for every bit set in a row of closure_words() words, in vertex order
+    template<typename F>
+    void for_each_set(const uint64_t *row, F f) const {
+        for (size_t w = 0; w < words; ++w) {
+            for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+                f(static_cast<Vertex>(w * 64 + count_trailing_zeros(bits)));
+            }
+        }
+    }
+
+private:
+    std::vector<std::vector<Vertex>> callee_lists;
+    std::vector<std::vector<Vertex>> caller_lists;
+    std::vector<Vertex> components;
+    std::vector<char> recursive_flags;
+    std::vector<Vertex> order;
+    size_t component_total = 0;
+    std::vector<uint64_t> closure; // component_total rows of `words` words
+    size_t words = 0;
+    void compute_closure(ThreadPool &pool);
+
+    static size_t count_trailing_zeros(uint64_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return index;
+#else
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+    }
+};
+
+#endif //MINISPA_CALL_GRAPH_H
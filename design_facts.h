@@ -0,0 +1,97 @@
+#ifndef MINISPA_DESIGN_FACTS_H
+#define MINISPA_DESIGN_FACTS_H
+
+#include <utility>
+#include <vector>
+
+#include "nodes.h"
+
+// Direct design facts reported by the parser while it builds the AST, see Parser::set_fused_extraction.
+// Statements are named by their AST node; the PKB maps them onto TNodes once the tree is built and derives
+// the transitive relations and the ones through calls from these.
+class DesignFacts {
+public:
+    // procedure, while or if -> a statement of its statement lists
+    std::vector<std::pair<Node *, Node *>> parent;
+    // statement -> the statement after it; the last then statement is followed by the first else one,
+    // as then and else statements are one list of children in the TNode tree
+    std::vector<std::pair<Node *, Node *>> follows;
+    // assignments, each modifies the variable it assigns
+    std::vector<Assign *> modifies;
+    // assignments, whiles and ifs, each uses the variables of its expression or its condition variable
+    std::vector<Node *> uses;
+    // call statements, each is the parent of the procedure it calls
+    std::vector<Call *> calls;
+
+    void clear() {
+        parent.clear();
+        follows.clear();
+        modifies.clear();
+        uses.clear();
+        calls.clear();
+    }
+
+    void append(const DesignFacts &other) {
+        parent.insert(parent.end(), other.parent.begin(), other.parent.end());
+        follows.insert(follows.end(), other.follows.begin(), other.follows.end());
+        modifies.insert(modifies.end(), other.modifies.begin(), other.modifies.end());
+        uses.insert(uses.end(), other.uses.begin(), other.uses.end());
+        calls.insert(calls.end(), other.calls.begin(), other.calls.end());
+    }
+
+    // statements of a list are siblings in the order given
+    void add_stmt_list(Node *container, const NodeList &stmts, Node *before = nullptr) {
+        for (Node *stmt: stmts) {
+            parent.emplace_back(container, stmt);
+            if (before != nullptr) {
+                follows.emplace_back(before, stmt);
+            }
+            before = stmt;
+        }
+    }
+
+    // the facts the parser reports for a parsed procedure, for programs parsed without recording them
+    void add_procedure(Procedure *procedure) {
+        add_stmt_list(procedure, procedure->stmt_list);
+        add_stmts(procedure->stmt_list);
+    }
+
+private:
+    void add_stmts(const NodeList &stmts) {
+        for (Node *stmt: stmts) {
+            switch (stmt->kind) {
+                case NodeKind::WHILE: {
+                    auto while_stmt = static_cast<WhileStmt *>(stmt);
+                    add_stmt_list(while_stmt, while_stmt->stmt_list);
+                    uses.push_back(while_stmt);
+                    add_stmts(while_stmt->stmt_list);
+                    break;
+                }
+                case NodeKind::IF: {
+                    auto if_stmt = static_cast<IfStmt *>(stmt);
+                    const NodeList &then_stmts = if_stmt->then_stmt_list;
+                    add_stmt_list(if_stmt, then_stmts);
+                    add_stmt_list(if_stmt, if_stmt->else_stmt_list,
+                                  then_stmts.empty() ? nullptr : then_stmts[then_stmts.size() - 1]);
+                    uses.push_back(if_stmt);
+                    add_stmts(then_stmts);
+                    add_stmts(if_stmt->else_stmt_list);
+                    break;
+                }
+                case NodeKind::ASSIGN:
+                    modifies.push_back(static_cast<Assign *>(stmt));
+                    uses.push_back(stmt);
+                    break;
+                case NodeKind::CALL:
+                    calls.push_back(static_cast<Call *>(stmt));
+                    break;
+                case NodeKind::PROCEDURE:
+                case NodeKind::EXPR:
+                case NodeKind::FACTOR:
+                    break; // not statements
+            }
+        }
+    }
+};
+
+#endif //MINISPA_DESIGN_FACTS_H
@@ -0,0 +1,54 @@
+#include "expr_pool.h"
+
+Factor *ExprPool::factor(Arena &arena, NameId value, size_t line) {
+    Factor *&slot = factor_slot(value);
+    if (slot == nullptr) {
+        slot = arena.make<Factor>(value);
+        slot->mLineNumber = line;
+        nodes.push_back(slot);
+    }
+    return slot;
+}
+
+Expr *ExprPool::expr(Arena &arena, Node *left, char op, Node *right, size_t line) {
+    auto [it, inserted] = exprs.try_emplace(ExprKey{left, right, op}, nullptr);
+    if (inserted) {
+        it->second = arena.make<Expr>(left, op, right);
+        it->second->mLineNumber = line;
+        nodes.push_back(it->second);
+    }
+    return it->second;
+}
+
+std::unordered_map<const Node *, Node *> ExprPool::merge(ExprPool &other, const std::vector<NameId> &program_ids) {
+    std::unordered_map<const Node *, Node *> merged;
+    merged.reserve(other.nodes.size());
+    // children are met before their parents, so they are already merged
+    for (Node *node: other.nodes) {
+        if (auto factor = node_cast<Factor>(node)) {
+            NameId value = program_ids[factor->value];
+            Factor *&slot = factor_slot(value);
+            if (slot == nullptr) {
+                factor->value = value;
+                factor->hash = Factor::hash_of(value);
+                slot = factor;
+                nodes.push_back(factor);
+            }
+            merged.emplace(node, slot);
+        } else {
+            auto expr = static_cast<Expr *>(node);
+            Node *left = merged.at(expr->left);
+            Node *right = merged.at(expr->right);
+            auto [it, inserted] = exprs.try_emplace(ExprKey{left, right, expr->op}, expr);
+            if (inserted) {
+                expr->left = left;
+                expr->right = right;
+                expr->hash = Expr::hash_of(left, expr->op, right);
+                nodes.push_back(expr);
+            }
+            merged.emplace(node, it->second);
+        }
+    }
+    other.clear();
+    return merged;
+}
@@ -0,0 +1,76 @@
+#ifndef MINISPA_EXPR_POOL_H
+#define MINISPA_EXPR_POOL_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "nodes.h"
+
+// Hash-consing table for expressions: structurally equal expressions made through one pool are a single node,
+// so they are stored once and compared by pointer. Nodes are placed in the arena passed in, the pool only
+// indexes them. A shared node keeps the line of the expression it was first made for, the line of each use is
+// the one of its assignment (TNodeTable::line).
+class ExprPool {
+public:
+    ExprPool() = default;
+
+    ExprPool(ExprPool const &) = delete;
+
+    void operator=(ExprPool const &) = delete;
+
+    ExprPool(ExprPool &&) = default;
+
+    ExprPool &operator=(ExprPool &&) = default;
+
+    Factor *factor(Arena &arena, NameId value, size_t line);
+
+    // left and right must come from this pool
+    Expr *expr(Arena &arena, Node *left, char op, Node *right, size_t line);
+
+    // moves the expressions of other, whose factors hold ids of another NameTable, into this pool.
+    // program_ids maps those ids to the ones of this pool's factors; returns the node of this pool
+    // each node of other became, other is left empty
+    std::unordered_map<const Node *, Node *> merge(ExprPool &other, const std::vector<NameId> &program_ids);
+
+    // distinct expressions in the pool
+    [[nodiscard]] size_t size() const {
+        return nodes.size();
+    }
+
+    void clear() {
+        factors.clear();
+        exprs.clear();
+        nodes.clear();
+    }
+
+private:
+    struct ExprKey {
+        const Node *left;
+        const Node *right;
+        char op;
+
+        bool operator==(const ExprKey &other) const {
+            return left == other.left && right == other.right && op == other.op;
+        }
+    };
+
+    struct ExprKeyHash {
+        size_t operator()(const ExprKey &key) const {
+            return static_cast<size_t>(Expr::hash_of(key.left, key.op, key.right));
+        }
+    };
+
+    Factor *&factor_slot(NameId value) {
+        if (value >= factors.size()) {
+            factors.resize(value + 1, nullptr);
+        }
+        return factors[value];
+    }
+
+    std::vector<Factor *> factors; // by NameId, nullptr until first made
+    std::unordered_map<ExprKey, Expr *, ExprKeyHash> exprs;
+    std::vector<Node *> nodes; // in the order they were made, children before parents
+};
+
+#endif //MINISPA_EXPR_POOL_H
@@ -0,0 +1,376 @@
+#include "lexer_scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define LEXER_SCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LEXER_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace lexer_scan {
+    namespace {
+        inline unsigned count_trailing_zeros(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline unsigned popcount(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            return __popcnt(mask);
+#else
+            return static_cast<unsigned>(__builtin_popcount(mask));
+#endif
+        }
+
+        inline bool is_space(unsigned char c) {
+            return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+        }
+
+        inline bool is_digit(unsigned char c) {
+            return static_cast<unsigned char>(c - '0') <= 9;
+        }
+
+        inline bool is_alnum(unsigned char c) {
+            return is_digit(c) || static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+        }
+
+        // ---- scalar ----
+
+        size_t whitespace_run_scalar(const char *data, size_t size) {
+            size_t i = 0;
+            while (i < size && is_space(data[i])) ++i;
+            return i;
+        }
+
+        size_t alnum_run_scalar(const char *data, size_t size) {
+            size_t i = 0;
+            while (i < size && is_alnum(data[i])) ++i;
+            return i;
+        }
+
+        size_t digit_run_scalar(const char *data, size_t size) {
+            size_t i = 0;
+            while (i < size && is_digit(data[i])) ++i;
+            return i;
+        }
+
+        size_t find_brace_scalar(const char *data, size_t size) {
+            size_t i = 0;
+            while (i < size && data[i] != '{' && data[i] != '}') ++i;
+            return i;
+        }
+
+        size_t count_newlines_scalar(const char *data, size_t size) {
+            size_t count = 0;
+            for (size_t i = 0; i < size; ++i) {
+                count += data[i] == '\n';
+            }
+            return count;
+        }
+
+        void append_line_starts_scalar(const char *data, size_t size, size_t base, std::vector<size_t> &out) {
+            for (size_t i = 0; i < size; ++i) {
+                if (data[i] == '\n') out.push_back(base + i + 1);
+            }
+        }
+
+#if LEXER_SCAN_SSE2
+        // ---- SSE2, 16 bytes per step ----
+
+        // bytes with lo <= c <= hi (unsigned)
+        inline __m128i in_range_sse2(__m128i c, char lo, char hi) {
+            __m128i shifted = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+            return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), shifted);
+        }
+
+        inline __m128i space_mask_sse2(__m128i c) {
+            return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), in_range_sse2(c, '\t', '\r'));
+        }
+
+        inline __m128i digit_mask_sse2(__m128i c) {
+            return in_range_sse2(c, '0', '9');
+        }
+
+        inline __m128i alnum_mask_sse2(__m128i c) {
+            return _mm_or_si128(digit_mask_sse2(c), in_range_sse2(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z'));
+        }
+
+        // bit i set when byte i is outside the class
+        inline unsigned outside_sse2(__m128i class_mask) {
+            return ~static_cast<unsigned>(_mm_movemask_epi8(class_mask)) & 0xFFFFu;
+        }
+
+        inline __m128i load_sse2(const char *data) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        }
+
+        size_t whitespace_run_sse2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                unsigned outside = outside_sse2(space_mask_sse2(load_sse2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + whitespace_run_scalar(data + i, size - i);
+        }
+
+        size_t alnum_run_sse2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                unsigned outside = outside_sse2(alnum_mask_sse2(load_sse2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + alnum_run_scalar(data + i, size - i);
+        }
+
+        size_t digit_run_sse2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                unsigned outside = outside_sse2(digit_mask_sse2(load_sse2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + digit_run_scalar(data + i, size - i);
+        }
+
+        size_t find_brace_sse2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                __m128i c = load_sse2(data + i);
+                auto braces = static_cast<unsigned>(_mm_movemask_epi8(
+                        _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('{')), _mm_cmpeq_epi8(c, _mm_set1_epi8('}')))));
+                if (braces) return i + count_trailing_zeros(braces);
+            }
+            return i + find_brace_scalar(data + i, size - i);
+        }
+
+        size_t count_newlines_sse2(const char *data, size_t size) {
+            const __m128i newline = _mm_set1_epi8('\n');
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                count += popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(load_sse2(data + i), newline))));
+            }
+            return count + count_newlines_scalar(data + i, size - i);
+        }
+
+        void append_line_starts_sse2(const char *data, size_t size, size_t base, std::vector<size_t> &out) {
+            const __m128i newline = _mm_set1_epi8('\n');
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(load_sse2(data + i), newline)));
+                while (mask) {
+                    out.push_back(base + i + count_trailing_zeros(mask) + 1);
+                    mask &= mask - 1;
+                }
+            }
+            append_line_starts_scalar(data + i, size - i, base + i, out);
+        }
+#endif
+
+#if LEXER_SCAN_AVX2
+        // ---- AVX2, 32 bytes per step ----
+#define LEXER_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+
+        LEXER_SCAN_TARGET_AVX2 inline __m256i in_range_avx2(__m256i c, char lo, char hi) {
+            __m256i shifted = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), shifted);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 inline __m256i space_mask_avx2(__m256i c) {
+            return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), in_range_avx2(c, '\t', '\r'));
+        }
+
+        LEXER_SCAN_TARGET_AVX2 inline __m256i digit_mask_avx2(__m256i c) {
+            return in_range_avx2(c, '0', '9');
+        }
+
+        LEXER_SCAN_TARGET_AVX2 inline __m256i alnum_mask_avx2(__m256i c) {
+            return _mm256_or_si256(digit_mask_avx2(c),
+                                   in_range_avx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z'));
+        }
+
+        LEXER_SCAN_TARGET_AVX2 inline unsigned outside_avx2(__m256i class_mask) {
+            return ~static_cast<unsigned>(_mm256_movemask_epi8(class_mask));
+        }
+
+        LEXER_SCAN_TARGET_AVX2 inline __m256i load_avx2(const char *data) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        }
+
+        LEXER_SCAN_TARGET_AVX2 size_t whitespace_run_avx2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                unsigned outside = outside_avx2(space_mask_avx2(load_avx2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + whitespace_run_sse2(data + i, size - i);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 size_t alnum_run_avx2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                unsigned outside = outside_avx2(alnum_mask_avx2(load_avx2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + alnum_run_sse2(data + i, size - i);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 size_t digit_run_avx2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                unsigned outside = outside_avx2(digit_mask_avx2(load_avx2(data + i)));
+                if (outside) return i + count_trailing_zeros(outside);
+            }
+            return i + digit_run_sse2(data + i, size - i);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 size_t find_brace_avx2(const char *data, size_t size) {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i c = load_avx2(data + i);
+                auto braces = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(
+                        _mm256_cmpeq_epi8(c, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('}')))));
+                if (braces) return i + count_trailing_zeros(braces);
+            }
+            return i + find_brace_sse2(data + i, size - i);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 size_t count_newlines_avx2(const char *data, size_t size) {
+            const __m256i newline = _mm256_set1_epi8('\n');
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                count += popcount(static_cast<unsigned>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(load_avx2(data + i), newline))));
+            }
+            return count + count_newlines_sse2(data + i, size - i);
+        }
+
+        LEXER_SCAN_TARGET_AVX2 void append_line_starts_avx2(const char *data, size_t size, size_t base,
+                                                            std::vector<size_t> &out) {
+            const __m256i newline = _mm256_set1_epi8('\n');
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                auto mask = static_cast<unsigned>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(load_avx2(data + i), newline)));
+                while (mask) {
+                    out.push_back(base + i + count_trailing_zeros(mask) + 1);
+                    mask &= mask - 1;
+                }
+            }
+            append_line_starts_sse2(data + i, size - i, base + i, out);
+        }
+
+#undef LEXER_SCAN_TARGET_AVX2
+#endif
+
+        struct ScanTable {
+            Level level;
+            size_t (*whitespace_run)(const char *, size_t);
+            size_t (*alnum_run)(const char *, size_t);
+            size_t (*digit_run)(const char *, size_t);
+            size_t (*find_brace)(const char *, size_t);
+            size_t (*count_newlines)(const char *, size_t);
+            void (*append_line_starts)(const char *, size_t, size_t, std::vector<size_t> &);
+        };
+
+        const ScanTable scalar_table = {Level::SCALAR, whitespace_run_scalar, alnum_run_scalar, digit_run_scalar,
+                                        find_brace_scalar, count_newlines_scalar, append_line_starts_scalar};
+#if LEXER_SCAN_SSE2
+        const ScanTable sse2_table = {Level::SSE2, whitespace_run_sse2, alnum_run_sse2, digit_run_sse2,
+                                      find_brace_sse2, count_newlines_sse2, append_line_starts_sse2};
+#endif
+#if LEXER_SCAN_AVX2
+        const ScanTable avx2_table = {Level::AVX2, whitespace_run_avx2, alnum_run_avx2, digit_run_avx2,
+                                      find_brace_avx2, count_newlines_avx2, append_line_starts_avx2};
+#endif
+
+        const ScanTable &table_for(Level level) {
+            switch (level) {
+#if LEXER_SCAN_AVX2
+                case Level::AVX2:
+                    return avx2_table;
+#endif
+#if LEXER_SCAN_SSE2
+                case Level::SSE2:
+                    return sse2_table;
+#endif
+                default:
+                    return scalar_table;
+            }
+        }
+
+        const ScanTable *&active_table() {
+            static const ScanTable *table = &table_for(detected_level());
+            return table;
+        }
+    }
+
+    Level detected_level() {
+#if LEXER_SCAN_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return Level::AVX2;
+        }
+#endif
+#if LEXER_SCAN_SSE2
+        return Level::SSE2;
+#else
+        return Level::SCALAR;
+#endif
+    }
+
+    Level active_level() {
+        return active_table()->level;
+    }
+
+    void force_level(Level level) {
+        if (static_cast<int>(level) <= static_cast<int>(detected_level())) {
+            active_table() = &table_for(level);
+        }
+    }
+
+    const char *level_name(Level level) {
+        switch (level) {
+            case Level::AVX2:
+                return "AVX2";
+            case Level::SSE2:
+                return "SSE2";
+            default:
+                return "scalar";
+        }
+    }
+
+    size_t whitespace_run(const char *data, size_t size) {
+        return active_table()->whitespace_run(data, size);
+    }
+
+    size_t alnum_run(const char *data, size_t size) {
+        return active_table()->alnum_run(data, size);
+    }
+
+    size_t digit_run(const char *data, size_t size) {
+        return active_table()->digit_run(data, size);
+    }
+
+    size_t find_brace(const char *data, size_t size) {
+        return active_table()->find_brace(data, size);
+    }
+
+    size_t count_newlines(const char *data, size_t size) {
+        return active_table()->count_newlines(data, size);
+    }
+
+    void append_line_starts(const char *data, size_t size, size_t base, std::vector<size_t> &out) {
+        active_table()->append_line_starts(data, size, base, out);
+    }
+}
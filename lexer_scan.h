@@ -0,0 +1,44 @@
+#ifndef MINISPA_LEXER_SCAN_H
+#define MINISPA_LEXER_SCAN_H
+
+#include <cstddef>
+#include <vector>
+
+// Character-run scanning used by the Lexer. Every function looks at [data, data + size)
+// and processes 16 (SSE2) or 32 (AVX2) bytes per step, the implementation is picked once at
+// startup from what the CPU supports, with a scalar fallback for everything else.
+namespace lexer_scan {
+    enum class Level : int {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // length of the whitespace run at data (same set as isspace in the "C" locale)
+    size_t whitespace_run(const char *data, size_t size);
+
+    // length of the [A-Za-z0-9] run at data
+    size_t alnum_run(const char *data, size_t size);
+
+    // length of the [0-9] run at data
+    size_t digit_run(const char *data, size_t size);
+
+    // offset of the first '{' or '}', size when there is none
+    size_t find_brace(const char *data, size_t size);
+
+    size_t count_newlines(const char *data, size_t size);
+
+    // appends base + offset + 1 for every '\n' (start of the following line)
+    void append_line_starts(const char *data, size_t size, size_t base, std::vector<size_t> &out);
+
+    Level detected_level();
+
+    Level active_level();
+
+    // benchmarks only, levels the CPU can't run are ignored
+    void force_level(Level level);
+
+    const char *level_name(Level level);
+}
+
+#endif //MINISPA_LEXER_SCAN_H
@@ -80,15 +80,42 @@ void run_old_menu_mode() {
 }
 
 int main(int argc, char* argv[]) {
+    // options come before the source path
+    bool stream = false;
+    int arg = 1;
+    for (; arg < argc && std::string(argv[arg]).rfind("--", 0) == 0; ++arg) {
+        std::string option = argv[arg];
+        if (option == "--stream") {
+            stream = true; // read the source in chunks while parsing, for sources larger than memory
+        } else if (option == "--fused") {
+            Parser::instance().set_fused_extraction(true); // record direct relations while parsing
+        } else if (option == "--lazy-parent-star") {
+            PKB::instance().set_parent_star_materialized(false); // enumerate Parent* per query instead of storing it
+        } else if (option == "--lazy-follows-star") {
+            PKB::instance().set_follows_star_materialized(false); // same for Follows*
+        } else if (option.rfind("--threads=", 0) == 0 && option.size() > 10 &&
+                   option.find_first_not_of("0123456789", 10) == std::string::npos) {
+            // threads for parsing and building the PKB, 0 = one per core
+            size_t threads = std::stoul(option.substr(10));
+            Parser::instance().set_parse_threads(threads);
+            PKB::instance().set_build_threads(threads);
+        } else {
+            std::cerr << "# Unknown option: " << option << std::endl;
+            return -1;
+        }
+    }
+
     if (argc == 1) {
         // No arguments provided - run test mode
         run_old_menu_mode();
         return 0;
-    } else if (argc == 2) {
+    } else if (argc - arg == 1) {
         // Production mode for PipeTester
-        std::string path = argv[1];
+        std::string path = argv[arg];
         try {
-            if (!Parser::instance().initialize_by_file(path)) {
+            bool initialized = stream ? Parser::instance().initialize_by_stream(path)
+                                      : Parser::instance().initialize_by_file(path);
+            if (!initialized) {
                 std::cerr << "# Failed to initialize parser with file: " << path << std::endl;
                 return -1;
             }
@@ -128,7 +155,7 @@ int main(int argc, char* argv[]) {
         return 0;
     } else {
         std::cerr << "# Invalid number of arguments. Usage:" << std::endl;
-        std::cerr << "# spa.exe <path_to_source.txt>" << std::endl;
+        std::cerr << "# spa.exe [--stream] [--fused] [--lazy-parent-star] [--lazy-follows-star] [--threads=<n>] <path_to_source.txt>" << std::endl;
         return -1;
     }
 }
@@ -0,0 +1,17 @@
+#include "name_table.h"
+
+NameId NameTable::intern(std::string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    auto id = static_cast<NameId>(names.size());
+    const std::string &stored = names.emplace_back(name);
+    ids.emplace(stored, id);
+    return id;
+}
+
+NameId NameTable::find(std::string_view name) const {
+    auto it = ids.find(name);
+    return it != ids.end() ? it->second : NONE;
+}
@@ -0,0 +1,59 @@
+#ifndef MINISPA_NAME_TABLE_H
+#define MINISPA_NAME_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// dense id of an interned variable name, procedure name or constant
+using NameId = uint32_t;
+
+// Interning table: every distinct name is stored once and referred to by its id,
+// so names are compared as integers and only turned back into text for printing.
+// Ids are handed out in order of first appearance.
+class NameTable {
+public:
+    static constexpr NameId NONE = UINT32_MAX;
+
+    NameTable() = default;
+
+    NameTable(NameTable const &) = delete;
+
+    void operator=(NameTable const &) = delete;
+
+    NameTable(NameTable &&) = default;
+
+    NameTable &operator=(NameTable &&) = default;
+
+    // names of the parsed program
+    static NameTable &instance() {
+        static NameTable instance;
+        return instance;
+    }
+
+    NameId intern(std::string_view name);
+
+    // NONE if the name was never interned
+    [[nodiscard]] NameId find(std::string_view name) const;
+
+    [[nodiscard]] const std::string &name(NameId id) const {
+        return names[id];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return names.size();
+    }
+
+    void clear() {
+        ids.clear();
+        names.clear();
+    }
+
+private:
+    std::deque<std::string> names; // deque keeps the strings in place, ids view into them
+    std::unordered_map<std::string_view, NameId> ids;
+};
+
+#endif //MINISPA_NAME_TABLE_H
@@ -1,6 +1,6 @@
 #include "nodes.h"
 
-bool simple_semantic_utils::verify_name(const std::string &name) {
+bool simple_semantic_utils::verify_name(std::string_view name) {
     if (name.empty()) {
         return false;
     }
@@ -18,7 +18,7 @@ bool simple_semantic_utils::verify_name(const std::string &name) {
     return true;
 }
 
-bool simple_semantic_utils::verify_integer(const std::string &value) {
+bool simple_semantic_utils::verify_integer(std::string_view value) {
     if (value.empty()) {
         return false;
     }
@@ -32,21 +32,77 @@ bool simple_semantic_utils::verify_integer(const std::string &value) {
     return true;
 }
 
+namespace {
+    // splitmix64 finalizer
+    uint64_t mix(uint64_t h) {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+}
+
+uint64_t expression_hash(const Node *node) {
+    switch (node->kind) {
+        case NodeKind::EXPR:
+            return static_cast<const Expr *>(node)->hash;
+        case NodeKind::FACTOR:
+            return static_cast<const Factor *>(node)->hash;
+        default:
+            return 0;
+    }
+}
+
+uint64_t Expr::hash_of(const Node *left, char op, const Node *right) {
+    return mix(mix(expression_hash(left) + static_cast<unsigned char>(op)) ^ expression_hash(right));
+}
+
+uint64_t Factor::hash_of(NameId value) {
+    return mix(value);
+}
+
+void print_expression(const Node *node, int indent, size_t line) {
+    node->print_indent(indent);
+    if (auto expr = node_cast<Expr>(node)) {
+        std::cout << "Expr: " << expr->op << "[" << line << "]\n";
+        print_expression(expr->left, indent + 1, line);  // recur left
+        print_expression(expr->right, indent + 1, line);  // recur right
+    } else {
+        std::cout << "Factor: " << static_cast<const Factor *>(node)->get_value() << " [" << line << "]\n";
+    }
+}
+
 std::string get_node_type(Node *node) {
-    if (dynamic_cast<Procedure *>(node)) {
-        return "Procedure";
-    } else if (dynamic_cast<WhileStmt *>(node)) {
-        return "WhileStmt";
-    } else if (dynamic_cast<IfStmt *>(node)) {
-        return "IfStmt";
-    } else if (dynamic_cast<Assign *>(node)) {
-        return "Assign";
-    } else if (dynamic_cast<Expr *>(node)) {
-        return "Expr";
-    } else if (dynamic_cast<Factor *>(node)) {
-        return "Factor";
-    } else if (dynamic_cast<Call *>(node)) {
-        return "Call";
+    switch (node->kind) {
+        case NodeKind::PROCEDURE:
+            return "Procedure";
+        case NodeKind::WHILE:
+            return "WhileStmt";
+        case NodeKind::IF:
+            return "IfStmt";
+        case NodeKind::ASSIGN:
+            return "Assign";
+        case NodeKind::EXPR:
+            return "Expr";
+        case NodeKind::FACTOR:
+            return "Factor";
+        case NodeKind::CALL:
+            return "Call";
     }
     return "Unknown Node Type";
 }
+
+NameId get_node_name(Node *node) {
+    switch (node->kind) {
+        case NodeKind::PROCEDURE:
+            return static_cast<Procedure *>(node)->name;
+        case NodeKind::FACTOR:
+            return static_cast<Factor *>(node)->value;
+        case NodeKind::CALL:
+            return static_cast<Call *>(node)->proc_name;
+        default:
+            return NameTable::NONE;
+    }
+}
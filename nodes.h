@@ -1,24 +1,40 @@
 #ifndef MINISPA_NODES_H
 #define MINISPA_NODES_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
 #include "utils.h"
+#include "name_table.h"
 
 namespace simple_semantic_utils {
     //NAME : LETTER (LETTER | DIGIT)*
-    bool verify_name(const std::string &name);
+    bool verify_name(std::string_view name);
 
     //INTEGER: DIGIT+
-    bool verify_integer(const std::string &value);
+    bool verify_integer(std::string_view value);
 
 }
 
+// concrete class of a node, stored in the node so kinds are told apart without RTTI
+enum class NodeKind : uint8_t {
+    PROCEDURE,
+    WHILE,
+    IF,
+    ASSIGN,
+    EXPR,
+    FACTOR,
+    CALL
+};
+
+// Nodes live in an Arena and are never deleted through a Node pointer,
+// links between nodes are plain non-owning pointers
 class Node {
 public:
-    virtual ~Node() = default;
+    const NodeKind kind;
 
     [[nodiscard]] virtual std::string to_string() const = 0;
 
@@ -29,39 +45,67 @@ public:
     }
 
     size_t mLineNumber = 0;
+
+protected:
+    explicit Node(NodeKind kind) : kind(kind) {}
+
+    ~Node() = default;
 };
 
 // stmtLst : stmt+
 // stmt : assign | while
 
+// statement list, the array is stored in the same arena as the statements
+class NodeList {
+public:
+    NodeList() = default;
+
+    NodeList(Node *const *items, size_t count) : items(items), count(count) {}
+
+    [[nodiscard]] Node *const *begin() const { return items; }
+
+    [[nodiscard]] Node *const *end() const { return items + count; }
+
+    [[nodiscard]] size_t size() const { return count; }
+
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    Node *operator[](size_t index) const { return items[index]; }
+
+private:
+    Node *const *items = nullptr;
+    size_t count = 0;
+};
+
 // procedure : ‘procedure’ proc_name ‘{‘ stmtLst ‘}’
 class Procedure : public Node {
 public:
-    std::string name;
-    std::vector<std::shared_ptr<Node>> stmt_list{};
+    static constexpr NodeKind KIND = NodeKind::PROCEDURE;
 
-    Procedure(const std::string &name, const std::vector<std::shared_ptr<Node>> &stmt_list) {
+    NameId name;
+    NodeList stmt_list{};
+    size_t source_index = 0; // position among the procedures of the program, several can share one line
+
+    explicit Procedure(NameId name) : Node(KIND) {
         this->name = name;
-        this->stmt_list = stmt_list;
     }
 
-    explicit Procedure(const std::string &name) {
-        this->name = name;
-        this->stmt_list = {};
+    [[nodiscard]] const std::string &get_name() const {
+        return NameTable::instance().name(name);
     }
 
     [[nodiscard]] std::string to_string() const override {
-        std::string result = "===== PROCEDURE " + name + " at line " + std::to_string(mLineNumber) + " {\n";
+        std::string result = "===== PROCEDURE " + get_name() + " at line " + std::to_string(mLineNumber) + " {\n";
         for (const auto &stmt: stmt_list) {
             result += stmt->to_string() + "\n";
         }
-        result += "}\n===== END PROCEDURE " + name;
+        result += "}\n===== END PROCEDURE " + get_name();
         return result;
     }
 
     void print(int indent = 0) const override {
         print_indent(indent);
-        std::cout << "Procedure: " << name << "[" << mLineNumber << "]\n";
+        std::cout << "Procedure: " << get_name() << "[" << mLineNumber << "]\n";
         for (const auto &stmt: stmt_list) {
             stmt->print(indent + 1);
         }
@@ -71,26 +115,32 @@ public:
 // while : ‘while’ var_name ‘{‘ stmtLst ‘}’
 class WhileStmt : public Node {
 public:
-    std::string var_name;
-    std::vector<std::shared_ptr<Node>> stmt_list;
+    static constexpr NodeKind KIND = NodeKind::WHILE;
+
+    NameId var_name;
+    NodeList stmt_list;
 
-    WhileStmt(const std::string &var_name, const std::vector<std::shared_ptr<Node>> &stmt_list) {
+    WhileStmt(NameId var_name, NodeList stmt_list) : Node(KIND) {
         this->var_name = var_name;
         this->stmt_list = stmt_list;
     }
 
+    [[nodiscard]] const std::string &get_var_name() const {
+        return NameTable::instance().name(var_name);
+    }
+
     [[nodiscard]] std::string to_string() const override {
-        std::string result = "=== WHILE " + var_name + " {\n";
+        std::string result = "=== WHILE " + get_var_name() + " {\n";
         for (const auto &stmt: stmt_list) {
             result += stmt->to_string() + "\n";
         }
-        result += "}\n=== END WHILE " + var_name;
+        result += "}\n=== END WHILE " + get_var_name();
         return result;
     }
 
     void print(int indent = 0) const override {
         print_indent(indent);
-        std::cout << "While: " << var_name << " [" << mLineNumber << "]\n";
+        std::cout << "While: " << get_var_name() << " [" << mLineNumber << "]\n";
         for (const auto &stmt: stmt_list) {
             stmt->print(indent + 1);
         }
@@ -101,17 +151,21 @@ public:
 
 class IfStmt : public Node {
 public:
-    std::string var_name;
-    std::vector<std::shared_ptr<Node>> then_stmt_list;
-    std::vector<std::shared_ptr<Node>> else_stmt_list;
+    static constexpr NodeKind KIND = NodeKind::IF;
+
+    NameId var_name;
+    NodeList then_stmt_list;
+    NodeList else_stmt_list;
 
-    IfStmt(const std::string &var_name,
-           const std::vector<std::shared_ptr<Node>> &then_stmt_list,
-           const std::vector<std::shared_ptr<Node>> &else_stmt_list)
-            : var_name(var_name), then_stmt_list(then_stmt_list), else_stmt_list(else_stmt_list) {}
+    IfStmt(NameId var_name, NodeList then_stmt_list, NodeList else_stmt_list)
+            : Node(KIND), var_name(var_name), then_stmt_list(then_stmt_list), else_stmt_list(else_stmt_list) {}
+
+    [[nodiscard]] const std::string &get_var_name() const {
+        return NameTable::instance().name(var_name);
+    }
 
     [[nodiscard]] std::string to_string() const override {
-        std::string result = "=== if " + var_name + " then {\n";
+        std::string result = "=== if " + get_var_name() + " then {\n";
         for (const auto &stmt: then_stmt_list) {
             result += stmt->to_string() + "\n";
         }
@@ -125,7 +179,7 @@ public:
 
     void print(int indent = 0) const override {
         print_indent(indent);
-        std::cout << "If: " << var_name << "[" << mLineNumber << "]\n";
+        std::cout << "If: " << get_var_name() << "[" << mLineNumber << "]\n";
         print_indent(indent);
         std::cout << "Then:\n";
         for (const auto &stmt: then_stmt_list) {
@@ -140,52 +194,68 @@ public:
 };
 
 
+// prints an Expr or a Factor tree with every node at line; shared expression nodes only keep the line of their
+// first use, so a statement prints its expression at its own line
+void print_expression(const Node *node, int indent, size_t line);
+
 // assign : var_name ‘=’ expr ‘;’
 class Assign : public Node {
 public:
-    std::string var_name;
-    std::shared_ptr<Node> expr;
+    static constexpr NodeKind KIND = NodeKind::ASSIGN;
 
-    Assign(const std::string &var_name, const std::shared_ptr<Node> &expr) {
+    NameId var_name;
+    Node *expr;
+
+    Assign(NameId var_name, Node *expr) : Node(KIND) {
         this->var_name = var_name;
         this->expr = expr;
     }
 
+    [[nodiscard]] const std::string &get_var_name() const {
+        return NameTable::instance().name(var_name);
+    }
+
     [[nodiscard]] std::string to_string() const override {
-        return var_name + " = " + expr->to_string() + ";";
+        return get_var_name() + " = " + expr->to_string() + ";";
     }
 
     void print(int indent = 0) const override {
         print_indent(indent);
-        std::cout << "Assign: " << var_name << " [" << mLineNumber << "]\n";
-        expr->print(indent + 1);
+        std::cout << "Assign: " << get_var_name() << " [" << mLineNumber << "]\n";
+        print_expression(expr, indent + 1, mLineNumber);
     }
 
 
 };
 
+// structural hash of an Expr or a Factor, equal for structurally equal expressions
+uint64_t expression_hash(const Node *node);
+
 // expr : expr ‘+’ factor | factor
 class Expr : public Node {
 public:
-    std::shared_ptr<Node> left;
+    static constexpr NodeKind KIND = NodeKind::EXPR;
+
+    Node *left;
     char op;
-    std::shared_ptr<Node> right;
+    Node *right;
+    uint64_t hash; // see expression_hash
 
-    Expr(const std::shared_ptr<Node> &left, char op, const std::shared_ptr<Node> &right) {
+    Expr(Node *left, char op, Node *right) : Node(KIND) {
         this->left = left;
         this->op = op;
         this->right = right;
+        this->hash = hash_of(left, op, right);
     }
 
+    static uint64_t hash_of(const Node *left, char op, const Node *right);
+
     [[nodiscard]] std::string to_string() const override {
         return left->to_string() + " " + op + " " + right->to_string();
     }
 
     void print(int indent = 0) const override {
-        print_indent(indent);
-        std::cout << "Expr: " << op << "[" << mLineNumber << "]\n";
-        left->print(indent + 1);  // recur left
-        right->print(indent + 1);  // recur right
+        print_expression(this, indent, mLineNumber);
     }
 
 
@@ -197,26 +267,31 @@ public:
 // const_value : INTEGER
 
 // factor : var_name | const_value
-// store NAME or INTEGER
+// store NAME or INTEGER, both are interned
 class Factor : public Node {
 public:
-    std::string value;
+    static constexpr NodeKind KIND = NodeKind::FACTOR;
+
+    NameId value;
+    uint64_t hash; // see expression_hash
 
-    explicit Factor(const std::string &value) {
+    explicit Factor(NameId value) : Node(KIND) {
         this->value = value;
+        this->hash = hash_of(value);
     }
 
-    [[nodiscard]] std::string get_value() const {
-        return value;
+    static uint64_t hash_of(NameId value);
+
+    [[nodiscard]] const std::string &get_value() const {
+        return NameTable::instance().name(value);
     }
 
     [[nodiscard]] std::string to_string() const override {
-        return value;
+        return get_value();
     }
 
     void print(int indent = 0) const override {
-        print_indent(indent);
-        std::cout << "Factor: " << value << " [" << mLineNumber << "]\n";
+        print_expression(this, indent, mLineNumber);
     }
 
 
@@ -227,25 +302,45 @@ public:
 
 class Call : public Node {
 public:
-    std::string proc_name;
-    std::shared_ptr<Procedure> procedure;
+    static constexpr NodeKind KIND = NodeKind::CALL;
+
+    NameId proc_name;
+    Procedure *procedure = nullptr;
 
-    explicit Call(const std::string &proc_name) : proc_name(proc_name) {}
+    explicit Call(NameId proc_name) : Node(KIND), proc_name(proc_name) {}
+
+    [[nodiscard]] const std::string &get_proc_name() const {
+        return NameTable::instance().name(proc_name);
+    }
 
-    void set_procedure(const std::shared_ptr<Procedure> &proc) {
+    void set_procedure(Procedure *proc) {
         procedure = proc;
     }
 
     [[nodiscard]]  std::string to_string() const override {
-        return "call " + proc_name + ";";
+        return "call " + get_proc_name() + ";";
     }
 
     void print(int indent = 0) const override {
         print_indent(indent);
-        std::cout << ">>> Call: " << proc_name << "\n";
+        std::cout << ">>> Call: " << get_proc_name() << "\n";
     }
 };
 
+// node as a T when its kind tag says it is one, nullptr otherwise; dispatch on more than one kind switches on node->kind
+template<typename T>
+T *node_cast(Node *node) {
+    return node != nullptr && node->kind == T::KIND ? static_cast<T *>(node) : nullptr;
+}
+
+template<typename T>
+const T *node_cast(const Node *node) {
+    return node != nullptr && node->kind == T::KIND ? static_cast<const T *>(node) : nullptr;
+}
+
 std::string get_node_type(Node *node);
 
+// name a procedure, variable or constant node stands for, NameTable::NONE for other nodes
+NameId get_node_name(Node *node);
+
 #endif //MINISPA_NODES_H
@@ -2,13 +2,25 @@
 #define PARSER_H
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "utils.h"
 #include "nodes.h"
+#include "arena.h"
+#include "name_table.h"
+#include "expr_pool.h"
+#include "design_facts.h"
+#include "source_buffer.h"
+#include "source_stream.h"
+#include "lexer_scan.h"
+#include "thread_pool.h"
 
 
 enum TokenType : int {
@@ -32,9 +44,11 @@ enum TokenType : int {
     END // end of file
 };
 
+// value points into the Lexer's SourceBuffer and stays valid as long as the buffer does,
+// a streaming Lexer may drop it as soon as the next token is read
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
 
     [[nodiscard]] std::string to_string() const {
         switch (type) {
@@ -43,9 +57,9 @@ struct Token {
             case TokenType::WHILE:
                 return "WHILE";
             case TokenType::NAME:
-                return "NAME(" + value + ")";
+                return "NAME(" + std::string(value) + ")";
             case TokenType::INTEGER:
-                return "INTEGER(" + value + ")";
+                return "INTEGER(" + std::string(value) + ")";
             case TokenType::LBRACE:
                 return "LBRACE";
             case TokenType::RBRACE:
@@ -70,6 +84,47 @@ struct Token {
 };
 
 
+// keyword recognition: a switch on the length picks the only keyword an identifier can be (the first character
+// tells the three four letter ones apart), so most variable names are rejected without touching their characters
+// and a keyword costs one fixed length comparison
+namespace simple_keywords {
+    // word is keyword, which has the length of word
+    constexpr bool matches(std::string_view word, std::string_view keyword) {
+        return std::char_traits<char>::compare(word.data(), keyword.data(), keyword.size()) == 0;
+    }
+
+    // keyword token type for word, NAME when it isn't one; word must not be empty
+    constexpr TokenType classify(std::string_view word) {
+        switch (word.size()) {
+            case 2:
+                return matches(word, "if") ? TokenType::IF : TokenType::NAME;
+            case 4:
+                switch (word[0]) {
+                    case 'c':
+                        return matches(word, "call") ? TokenType::CALL : TokenType::NAME;
+                    case 't':
+                        return matches(word, "then") ? TokenType::THEN : TokenType::NAME;
+                    case 'e':
+                        return matches(word, "else") ? TokenType::ELSE : TokenType::NAME;
+                    default:
+                        return TokenType::NAME;
+                }
+            case 5:
+                return matches(word, "while") ? TokenType::WHILE : TokenType::NAME;
+            case 9:
+                return matches(word, "procedure") ? TokenType::PROCEDURE : TokenType::NAME;
+            default:
+                return TokenType::NAME;
+        }
+    }
+
+    static_assert(classify("procedure") == TokenType::PROCEDURE && classify("while") == TokenType::WHILE &&
+                  classify("call") == TokenType::CALL && classify("if") == TokenType::IF &&
+                  classify("then") == TokenType::THEN && classify("else") == TokenType::ELSE &&
+                  classify("iff") == TokenType::NAME && classify("thin") == TokenType::NAME,
+                  "simple_keywords::classify does not recognize the SIMPLE keywords");
+}
+
 /*
 NAME : LETTER (LETTER | DIGIT)*
 INTEGER: DIGIT+
@@ -86,87 +141,194 @@ const_value : INTEGER
 
 class Lexer {
 private:
-    std::string code;
+    std::shared_ptr<const SourceBuffer> source;
+    std::string_view code; // view of the whole source, or of the window in streaming mode
     size_t pos;
     char currentChar;
-    size_t line;
-    size_t column;
+    std::shared_ptr<const std::vector<size_t>> line_starts; // offset of the first character of every line
+    mutable size_t line_hint = 0;    // index into line_starts of the last lookup
 
-    void advance() {
-        if (currentChar == '\n') {
-            line++;
-            column = 0;
-        } else {
-            column++;
-        }
+    // streaming mode: only a window of the source is held, text before the token being read is dropped
+    // whenever the window is refilled, so memory stays within a couple of chunks however large the file is
+    std::shared_ptr<SourceStream> stream;
+    std::string window;
+    size_t window_line = 0;   // lines before the window
+    size_t window_column = 0; // column of the window's first character in its line
+    size_t peak_window = 0;
 
+    void advance() {
         pos++;
         currentChar = (pos < code.size()) ? code[pos] : '\0';
     }
 
+    // text between start and the current position
+    std::string_view slice_from(size_t start) const {
+        return code.substr(start, pos - start);
+    }
+
+    // moves past a run found by one of the lexer_scan functions
+    void advance_by(size_t count) {
+        pos += count;
+        currentChar = (pos < code.size()) ? code[pos] : '\0';
+    }
+
+    // moves past a run found by scan, in streaming mode a run reaching the end of the window continues
+    // into the next chunk; keep_from is the start of the token being read and is moved with the window
+    void advance_run(size_t (*scan)(const char *, size_t), size_t &keep_from) {
+        advance_by(scan(code.data() + pos, code.size() - pos));
+        while (pos == code.size() && refill(keep_from)) {
+            advance_by(scan(code.data() + pos, code.size() - pos));
+        }
+    }
+
     void skip_whitespace() {
-        while (isspace(currentChar)) {
-            advance();
+        size_t keep_from = pos;
+        advance_run(lexer_scan::whitespace_run, keep_from);
+    }
+
+    // drops the window before keep_from and reads the next chunk, false at the end of the stream
+    bool refill(size_t &keep_from) {
+        if (!stream) {
+            return false;
+        }
+        std::string_view dropped = code.substr(0, keep_from);
+        size_t last_newline = dropped.rfind('\n');
+        window_line += lexer_scan::count_newlines(dropped.data(), dropped.size());
+        window_column = last_newline == std::string_view::npos ? window_column + keep_from
+                                                                : keep_from - last_newline - 1;
+        window.erase(0, keep_from);
+        pos -= keep_from;
+        keep_from = 0;
+
+        size_t read = stream->read_chunk(window);
+        peak_window = std::max(peak_window, window.capacity());
+        code = window;
+        currentChar = (pos < code.size()) ? code[pos] : '\0';
+        build_line_index();
+        line_hint = 0;
+        if (read == 0) {
+            stream.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void build_line_index() {
+        auto starts = std::make_shared<std::vector<size_t>>();
+        starts->reserve(lexer_scan::count_newlines(code.data(), code.size()) + 1);
+        starts->push_back(0);
+        lexer_scan::append_line_starts(code.data(), code.size(), 0, *starts);
+        line_starts = std::move(starts);
+    }
+
+    // index of the line containing offset, parsing moves forward so the last hit is checked before searching
+    size_t line_index_at(size_t offset) const {
+        const auto &starts = *line_starts;
+        if (starts[line_hint] <= offset &&
+            (line_hint + 1 == starts.size() || offset < starts[line_hint + 1])) {
+            return line_hint;
         }
+        auto it = std::upper_bound(starts.begin(), starts.end(), offset);
+        line_hint = static_cast<size_t>(it - starts.begin()) - 1;
+        return line_hint;
     }
 
 public:
     size_t get_pos() const { return pos; }
 
-    size_t get_line() const { return line; }
+    size_t get_line() const { return line_at(pos); }
+
+    size_t get_column() const { return column_at(pos); }
 
-    size_t get_column() const { return column; }
+    // 1-based line of the given offset
+    size_t line_at(size_t offset) const { return window_line + line_index_at(offset) + 1; }
+
+    // 1-based column of the given offset
+    size_t column_at(size_t offset) const {
+        size_t index = line_index_at(offset);
+        return offset - (*line_starts)[index] + 1 + (index == 0 ? window_column : 0);
+    }
+
+    // numbers the lines so that the current position is on line, for code cut out of a larger source
+    void set_current_line(size_t line) { window_line += line - get_line(); }
+
+    [[nodiscard]] bool is_streaming() const { return source == nullptr; }
+
+    // largest window held so far in streaming mode, in bytes
+    [[nodiscard]] size_t get_peak_window() const { return peak_window; }
 
     void set_pos(size_t new_pos) {
         pos = new_pos;
         currentChar = (pos < code.size()) ? code[pos] : '\0';
+    }
 
-        // Recalculate line and column
-        line = 1;
-        column = 1;
-        for (size_t i = 0; i < pos; ++i) {
-            if (code[i] == '\n') {
-                line++;
-                column = 1;
-            } else {
-                column++;
-            }
-        }
+    explicit Lexer(std::shared_ptr<const SourceBuffer> source)
+            : source(std::move(source)), pos(0) {
+        code = this->source->view();
+        currentChar = (pos < code.size()) ? code[pos] : '\0';
+        build_line_index();
     }
 
     explicit Lexer(const std::string &code)
-            : code(code), pos(0), line(1), column(1) {
-        currentChar = (pos < code.size()) ? code[pos] : '\0';
+            : Lexer(SourceBuffer::from_string(code)) {}
+
+    // streaming mode, reads the source chunk by chunk as tokens are requested
+    explicit Lexer(std::shared_ptr<SourceStream> source_stream)
+            : pos(0), stream(std::move(source_stream)) {
+        size_t keep_from = 0;
+        build_line_index();
+        refill(keep_from);
+    }
+
+    // independent cursor over the same source and line index, starting at offset
+    [[nodiscard]] std::unique_ptr<Lexer> cursor_at(size_t offset) const {
+        if (is_streaming()) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cursors need the whole source in memory");
+            return nullptr;
+        }
+        auto cursor = std::make_unique<Lexer>(*this);
+        cursor->set_pos(offset);
+        return cursor;
+    }
+
+    // offset just past the '}' closing the block whose '{' ends right before offset,
+    // braces only appear as tokens in SIMPLE so the body is not tokenized; size of the source when unbalanced
+    [[nodiscard]] size_t find_block_end(size_t offset) const {
+        size_t depth = 1;
+        while (offset < code.size()) {
+            offset += lexer_scan::find_brace(code.data() + offset, code.size() - offset);
+            if (offset == code.size()) {
+                break;
+            }
+            if (code[offset] == '{') {
+                depth++;
+            } else {
+                depth--;
+            }
+            offset++;
+            if (depth == 0) {
+                break;
+            }
+        }
+        return offset;
     }
 
     Token next_token() {
         skip_whitespace();
 
         if (isalpha(currentChar)) {
-            std::string value;
-            while (isalnum(currentChar)) {
-                value += currentChar;
-                advance();
-            }
-
-            if (value == "procedure") return {TokenType::PROCEDURE, value};
-            if (value == "while") return {TokenType::WHILE, value};
-            if (value == "call") return {TokenType::CALL, value};
-            if (value == "if") return {TokenType::IF, value};
-            if (value == "then") return {TokenType::THEN, value};
-            if (value == "else") return {TokenType::ELSE, value};
+            size_t start = pos;
+            advance_run(lexer_scan::alnum_run, start);
+            std::string_view value = slice_from(start);
 
-            return {TokenType::NAME, value};
+            return {simple_keywords::classify(value), value};
         }
 
         if (isdigit(currentChar)) {
-            std::string value;
-            while (isdigit(currentChar)) {
-                value += currentChar;
-                advance();
-            }
+            size_t start = pos;
+            advance_run(lexer_scan::digit_run, start);
 
-            return {TokenType::INTEGER, value};
+            return {TokenType::INTEGER, slice_from(start)};
         }
 
         if (currentChar == '{') {
@@ -211,24 +373,29 @@ public:
         }
 
         fatal_error(__PRETTY_FUNCTION__, __LINE__,
-                    "Error at line " + std::to_string(line) +
-                    ", column " + std::to_string(column) +
+                    "Error at line " + std::to_string(get_line()) +
+                    ", column " + std::to_string(get_column()) +
                     ": Unexpected character '" + std::string(1, currentChar) + "'");
 
         return {TokenType::END, ""}; // just to satisfy return type
     }
 };
 
-struct UnresolvedProcedure {
-    std::string name;
-    size_t lexer_pos;
-};
-
 class Parser {
 private:
     Token currentToken{};
-    std::map<std::string, std::shared_ptr<Procedure>> procedures;  // Procedure map
-    std::vector<UnresolvedProcedure> unresolved_procedures; //procedures waiting to pare with Call
+    std::vector<std::unique_ptr<Arena>> arenas; // hold every node of the parsed program
+    std::map<std::string, Procedure *> procedures;  // Procedure map
+    std::vector<Call *> unresolved_calls; //calls waiting to pair with Procedure
+    Arena *arena = nullptr; // where new nodes are placed
+    NameTable *names = &NameTable::instance(); // where names of new nodes are interned
+    ExprPool expressions; // expressions of the parsed program
+    ExprPool *exprs = &expressions; // where new expressions are hash-consed
+    bool fused_extraction = false; // see set_fused_extraction
+    bool facts_recorded = false; // design_facts describe the parsed program
+    DesignFacts design_facts; // direct design facts of the parsed program
+    DesignFacts *facts = nullptr; // where design facts are reported, nullptr when they are not recorded
+    std::vector<Node *> open_stmts; // statements of the lists being parsed, innermost list last
     //verify if current token is the expected one
     //if so, eat it and read the next one (and set it as current)
     void eat_and_read_next_token(TokenType type) {
@@ -240,44 +407,223 @@ private:
         }
     }
 
-    static bool load_code_from_file(const std::string &filePath, std::string &code) {
-        //open file
-        std::ifstream t(filePath);
-        if (!t) {
-            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot open file " + filePath);
-            return false;
+    // calls may refer to procedures defined later in the file, so they are bound once all procedures are known
+    void resolve_calls() {
+        for (const auto &call: unresolved_calls) {
+            auto it = procedures.find(call->get_proc_name());
+            if (it != procedures.end()) {
+                call->set_procedure(it->second);
+            } else {
+                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Call to undefined procedure: " + call->get_proc_name());
+            }
         }
+        unresolved_calls.clear();
+    }
 
-        std::stringstream buffer;
-        buffer << t.rdbuf();
+    //private constructor
+    Parser() = default;
 
-        code = buffer.str();
+    // worker parsing one procedure body through its own cursor, see parse_program_parallel
+    Parser(std::unique_ptr<Lexer> cursor, Arena &chunk_arena, NameTable &chunk_names, ExprPool &chunk_exprs)
+            : arena(&chunk_arena), names(&chunk_names), exprs(&chunk_exprs), lexer(std::move(cursor)) {
+        currentToken = lexer->next_token();
+        initialized = true;
+    }
 
-        if (code.empty()) {
-            fatal_error(__PRETTY_FUNCTION__, __LINE__, "File is empty");
-            return false;
-        } else {
-//            std::cout << "Wczytano kod:\n" << code << std::endl;
-            return true;
+    struct ProcedureHeader {
+        Procedure *procedure;
+        std::string_view name; // interned when the bodies are merged, to keep the sequential order of ids
+        size_t body_start; // offset of the body's '{'
+        size_t chunk_names_end = 0; // chunk name count once the body is parsed
+    };
+
+    // procedures whose bodies share one arena in a parallel parse, keeps blocks full without sharing them between threads
+    static constexpr size_t PARALLEL_PARSE_CHUNK = 16;
+
+    size_t parse_threads = 1; // see set_parse_threads
+    std::unique_ptr<ThreadPool> parse_pool; // started by the first parallel parse_program, kept for later ones
+
+    // reads every procedure header with the main lexer, bodies are only brace-matched and skipped
+    std::vector<ProcedureHeader> scan_procedure_headers() {
+        std::vector<ProcedureHeader> headers;
+        while (currentToken.type == TokenType::PROCEDURE) {
+            eat_and_read_next_token(TokenType::PROCEDURE);
+            std::string_view name = currentToken.value;
+            eat_and_read_next_token(TokenType::NAME);
+            if (currentToken.type != TokenType::LBRACE) {
+                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expected '{' after procedure name");
+            }
+
+            auto procedure = arena->make<Procedure>(NameTable::NONE);
+            procedure->mLineNumber = lexer->get_line();
+            procedure->source_index = headers.size();
+            headers.push_back({procedure, name, lexer->get_pos() - 1});
+
+            lexer->set_pos(lexer->find_block_end(lexer->get_pos()));
+            currentToken = lexer->next_token();
         }
+        return headers;
     }
 
-    void skip_block() {
-        int brace_count = 1;
-        while (brace_count > 0 && currentToken.type != TokenType::END) {
-            currentToken = lexer->next_token();
-            if (currentToken.type == TokenType::LBRACE) brace_count++;
-            if (currentToken.type == TokenType::RBRACE) brace_count--;
+    // single pass: every procedure body is lexed exactly once, calls are resolved afterwards
+    void parse_program_sequential() {
+        arena = &new_arena();
+        size_t source_index = 0;
+        while (currentToken.type == TokenType::PROCEDURE) {
+            eat_and_read_next_token(TokenType::PROCEDURE);
+            NameId name = names->intern(currentToken.value); // before the token is dropped by a streaming lexer
+            eat_and_read_next_token(TokenType::NAME);
+            if (currentToken.type != TokenType::LBRACE) {
+                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expected '{' after procedure name");
+            }
+
+            auto procedure = arena->make<Procedure>(name);
+            procedure->mLineNumber = lexer->get_line();
+            procedure->source_index = source_index++;
+
+            eat_and_read_next_token(TokenType::LBRACE);
+            procedure->stmt_list = parse_stmt_list();
+            eat_and_read_next_token(TokenType::RBRACE);
+            if (facts != nullptr) {
+                facts->add_stmt_list(procedure, procedure->stmt_list);
+            }
+
+            procedures[procedure->get_name()] = procedure;
         }
+        resolve_calls();
     }
 
-    //private constructor
-    Parser() = default;
+    // procedure bodies are independent once the headers are known: each one is parsed by a worker with its
+    // own cursor over the shared source, results are merged in source order so the outcome is deterministic.
+    // Workers intern names into a table of their chunk, the merge moves them into the program table in the
+    // order a sequential parse would have met them and the chunk ids in the nodes are then replaced.
+    // Expressions are hash-consed per chunk as well and merged into the program pool the same way
+    void parse_program_parallel(ThreadPool &pool) {
+        arena = &new_arena();
+        auto headers = scan_procedure_headers();
+
+        size_t chunks = (headers.size() + PARALLEL_PARSE_CHUNK - 1) / PARALLEL_PARSE_CHUNK;
+        std::vector<Arena *> chunk_arenas;
+        for (size_t c = 0; c < chunks; ++c) {
+            chunk_arenas.push_back(&new_arena());
+        }
+        std::vector<NameTable> chunk_names(chunks);
+        std::vector<ExprPool> chunk_exprs(chunks);
+        std::vector<DesignFacts> chunk_facts(facts != nullptr ? chunks : 0);
+
+        std::vector<std::vector<Call *>> calls(headers.size());
+        pool.parallel_for(chunks, [&](size_t c) {
+            size_t end = std::min(headers.size(), (c + 1) * PARALLEL_PARSE_CHUNK);
+            for (size_t i = c * PARALLEL_PARSE_CHUNK; i < end; ++i) {
+                Parser worker(lexer->cursor_at(headers[i].body_start), *chunk_arenas[c], chunk_names[c],
+                              chunk_exprs[c]);
+                worker.facts = facts != nullptr ? &chunk_facts[c] : nullptr;
+                worker.eat_and_read_next_token(TokenType::LBRACE);
+                headers[i].procedure->stmt_list = worker.parse_stmt_list();
+                worker.eat_and_read_next_token(TokenType::RBRACE);
+                headers[i].chunk_names_end = chunk_names[c].size();
+                calls[i] = std::move(worker.unresolved_calls);
+            }
+        });
+
+        std::vector<std::vector<NameId>> program_ids(chunks);
+        for (size_t i = 0; i < headers.size(); ++i) {
+            size_t c = i / PARALLEL_PARSE_CHUNK;
+            headers[i].procedure->name = names->intern(headers[i].name);
+            for (size_t id = program_ids[c].size(); id < headers[i].chunk_names_end; ++id) {
+                program_ids[c].push_back(names->intern(chunk_names[c].name(static_cast<NameId>(id))));
+            }
+        }
+        std::vector<std::unordered_map<const Node *, Node *>> merged_exprs(chunks);
+        for (size_t c = 0; c < chunks; ++c) {
+            merged_exprs[c] = expressions.merge(chunk_exprs[c], program_ids[c]);
+        }
+
+        pool.parallel_for(chunks, [&](size_t c) {
+            size_t end = std::min(headers.size(), (c + 1) * PARALLEL_PARSE_CHUNK);
+            for (size_t i = c * PARALLEL_PARSE_CHUNK; i < end; ++i) {
+                rename(headers[i].procedure->stmt_list, program_ids[c], merged_exprs[c]);
+            }
+        });
+
+        for (size_t i = 0; i < headers.size(); ++i) {
+            procedures[headers[i].procedure->get_name()] = headers[i].procedure;
+            unresolved_calls.insert(unresolved_calls.end(), calls[i].begin(), calls[i].end());
+            if (facts != nullptr) {
+                facts->add_stmt_list(headers[i].procedure, headers[i].procedure->stmt_list);
+            }
+        }
+        for (const DesignFacts &chunk: chunk_facts) {
+            facts->append(chunk);
+        }
+        resolve_calls();
+    }
+
+    // replaces the chunk name ids in a parsed statement list with program ids and the chunk expressions
+    // with the program ones they were merged into
+    using ExprMap = std::unordered_map<const Node *, Node *>;
+
+    static void rename(const NodeList &stmt_list, const std::vector<NameId> &program_ids, const ExprMap &merged) {
+        for (Node *stmt: stmt_list) {
+            rename(stmt, program_ids, merged);
+        }
+    }
+
+    static void rename(Node *node, const std::vector<NameId> &program_ids, const ExprMap &merged) {
+        switch (node->kind) {
+            case NodeKind::WHILE: {
+                auto while_stmt = static_cast<WhileStmt *>(node);
+                while_stmt->var_name = program_ids[while_stmt->var_name];
+                rename(while_stmt->stmt_list, program_ids, merged);
+                break;
+            }
+            case NodeKind::IF: {
+                auto if_stmt = static_cast<IfStmt *>(node);
+                if_stmt->var_name = program_ids[if_stmt->var_name];
+                rename(if_stmt->then_stmt_list, program_ids, merged);
+                rename(if_stmt->else_stmt_list, program_ids, merged);
+                break;
+            }
+            case NodeKind::ASSIGN: {
+                auto assign = static_cast<Assign *>(node);
+                assign->var_name = program_ids[assign->var_name];
+                assign->expr = merged.at(assign->expr);
+                break;
+            }
+            case NodeKind::CALL: {
+                auto call = static_cast<Call *>(node);
+                call->proc_name = program_ids[call->proc_name];
+                break;
+            }
+            case NodeKind::PROCEDURE:
+            case NodeKind::EXPR:
+            case NodeKind::FACTOR:
+                break; // expressions are renamed when their pool is merged
+        }
+    }
+
+    Arena &new_arena() {
+        arenas.push_back(std::make_unique<Arena>());
+        return *arenas.back();
+    }
+
+    // nodes are only released here, when a new program replaces the parsed one
+    void reset_program() {
+        procedures.clear();
+        NameTable::instance().clear();
+        expressions.clear();
+        design_facts.clear();
+        facts_recorded = false;
+        unresolved_calls.clear();
+        parsed_tree = nullptr;
+        arena = nullptr;
+        arenas.clear();
+    }
 
 public:
     std::unique_ptr<Lexer> lexer;
     bool initialized = false;
-    std::shared_ptr<Procedure> parsed_tree;
+    Procedure *parsed_tree = nullptr;
 
     //don't allow copying
     Parser(Parser const &) = delete;
@@ -289,18 +635,23 @@ public:
         return instance;
     }
 
-    const std::map<std::string, std::shared_ptr<Procedure>> &get_all_procedures() const {
+    const std::map<std::string, Procedure *> &get_all_procedures() const {
         return procedures;
     }
 
 
     bool initialize_by_file(const std::string &filePath) {
-        std::string code;
-        if (!load_code_from_file(filePath, code)) {
+        auto source = SourceBuffer::from_file(filePath);
+        if (!source) {
+            return false;
+        }
+        if (source->view().empty()) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "File is empty");
             return false;
         }
 
-        this->lexer = std::make_unique<Lexer>(code);
+        this->lexer = std::make_unique<Lexer>(std::move(source));
+        reset_program();
 
         //read first token
         currentToken = this->lexer->next_token();
@@ -308,12 +659,33 @@ public:
         return true;
     }
 
+    // the file is read in chunks while parsing instead of being loaded up front, always parsed sequentially
+    bool initialize_by_stream(const std::string &filePath, size_t chunk_size = SourceStream::DEFAULT_CHUNK_SIZE) {
+        auto stream = SourceStream::open(filePath, chunk_size);
+        if (!stream) {
+            return false;
+        }
+
+        this->lexer = std::make_unique<Lexer>(std::move(stream));
+        reset_program();
+
+        //read first token
+        currentToken = this->lexer->next_token();
+        if (currentToken.type == TokenType::END) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "File is empty");
+            return false;
+        }
+        this->initialized = true;
+        return true;
+    }
+
     bool initialize_by_raw_code(const std::string &code) {
         if (code.empty()) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Empty code");
             return false;
         }
         this->lexer = std::make_unique<Lexer>(code);
+        reset_program();
 
         //read first token
         currentToken = this->lexer->next_token();
@@ -322,81 +694,128 @@ public:
     }
 
 
-    std::shared_ptr<Procedure> parse_procedure() {
+    Procedure *parse_procedure() {
         eat_and_read_next_token(TokenType::PROCEDURE);
 
         //after 'procedure' keyword, there should be a name of the procedure
-        std::string name = currentToken.value;
-        size_t procLine = lexer->get_line();
+        if (arena == nullptr) {
+            arena = &new_arena();
+        }
+        auto procedure = arena->make<Procedure>(names->intern(currentToken.value));
+        procedure->mLineNumber = lexer->get_line();
+        procedure->source_index = procedures.size();
         eat_and_read_next_token(TokenType::NAME);
         eat_and_read_next_token(TokenType::LBRACE);
 
-        auto stmt_list = parse_stmt_list();
-        if (stmt_list.empty()) {
+        procedure->stmt_list = parse_stmt_list();
+        if (procedure->stmt_list.empty()) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Empty procedure");
             return nullptr;
         }
+        if (facts != nullptr) {
+            facts->add_stmt_list(procedure, procedure->stmt_list);
+        }
 
         eat_and_read_next_token(TokenType::RBRACE);
-        parsed_tree = std::make_shared<Procedure>(name, stmt_list);
-        parsed_tree->mLineNumber = lexer->get_line();
-        parsed_tree->print();
+        parsed_tree = procedure;
+        procedures[procedure->get_name()] = procedure;
+        resolve_calls();
+        std::cout << "Parsed procedure: " << parsed_tree->get_name() << " with " << parsed_tree->stmt_list.size()
+                  << " statements\n";
 
-        auto procedure = std::make_shared<Procedure>(name, stmt_list);
-        procedure->mLineNumber = procLine;
-
-        procedures[name] = procedure;
-        std::cout << "Parsed procedure: " << name << " with " << stmt_list.size() << " statements\n";
-
-        procedure->print();
+        parsed_tree->print();
 
         return parsed_tree;
     }
 
     void parse_program() {
-        // F1
-        while (currentToken.type == TokenType::PROCEDURE) {
-            eat_and_read_next_token(TokenType::PROCEDURE);
-            std::string name = currentToken.value;
-            size_t block_start = lexer->get_pos();
-            eat_and_read_next_token(TokenType::NAME);
-            if (currentToken.type != TokenType::LBRACE) {
-                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expected '{' after procedure name");
+        facts = fused_extraction ? &design_facts : nullptr;
+        size_t threads = ThreadPool::resolve_thread_count(parse_threads);
+        if (threads > 1 && !lexer->is_streaming()) {
+            if (!parse_pool) {
+                parse_pool = std::make_unique<ThreadPool>(threads);
             }
+            parse_pool->resize(threads);
+            parse_program_parallel(*parse_pool);
+        } else {
+            parse_program_sequential();
+        }
+        facts_recorded = fused_extraction;
+        facts = nullptr;
+    }
 
-            auto procedure = std::make_shared<Procedure>(name);
-            procedure->mLineNumber = lexer->get_line();
+    // parses code holding one procedure of the parsed program and swaps its statements into that procedure.
+    // The Procedure node stays the same, so calls to it remain bound; the nodes of the old body stay in their
+    // arena until the next program is loaded
+    Procedure *replace_procedure(const std::string &code) {
+        if (!initialized) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Parser is not initialized.");
+            return nullptr;
+        }
 
-            procedures[name] = procedure;
-//            std::cout << "Found procedure: " << name << " at position " << block_start << "at line: " << lexer->get_line() << std::endl;
-            unresolved_procedures.push_back({name, block_start});
-            skip_block();
-            currentToken = lexer->next_token();
+        Parser worker(std::make_unique<Lexer>(code), new_arena(), *names, *exprs);
+        worker.eat_and_read_next_token(TokenType::PROCEDURE);
+        auto it = procedures.find(std::string(worker.currentToken.value));
+        if (it == procedures.end()) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__,
+                        "Unknown procedure: " + std::string(worker.currentToken.value));
+            return nullptr;
         }
-        // F2
-        for (const auto &up: unresolved_procedures) {
-            lexer->set_pos(up.lexer_pos);
-            currentToken = lexer->next_token();
-            eat_and_read_next_token(TokenType::LBRACE);
-            auto stmt_list = parse_stmt_list();
-            eat_and_read_next_token(TokenType::RBRACE);
-            procedures[up.name]->stmt_list = stmt_list;
+        worker.eat_and_read_next_token(TokenType::NAME);
+        // lines of the new body count on from where the procedure starts in the program
+        worker.lexer->set_current_line(it->second->mLineNumber);
+        worker.eat_and_read_next_token(TokenType::LBRACE);
+        NodeList stmt_list = worker.parse_stmt_list();
+        worker.eat_and_read_next_token(TokenType::RBRACE);
+        if (worker.currentToken.type != TokenType::END) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expected a single procedure");
+            return nullptr;
         }
+
+        unresolved_calls = std::move(worker.unresolved_calls);
+        resolve_calls();
+        it->second->stmt_list = stmt_list;
+        // the recorded facts still name the old body
+        design_facts.clear();
+        facts_recorded = false;
+        return it->second;
     }
 
-    std::vector<std::shared_ptr<Node>> parse_stmt_list() {
-        std::vector<std::shared_ptr<Node>> stmts;
+    // number of threads parse_program may use, 0 = one per core, 1 = sequential single-pass parse. 1 by default:
+    // a parallel parse reads every procedure header first, which small programs pay for without gaining anything
+    void set_parse_threads(size_t threads) {
+        parse_threads = threads;
+    }
+
+    // when enabled, parse_program records the direct Parent, Follows, Modifies, Uses and call facts while it
+    // parses, so PKB::initialize does not have to search the tree for them
+    void set_fused_extraction(bool enabled) {
+        fused_extraction = enabled;
+    }
+
+    // facts recorded by the last parse_program, nullptr when none were recorded or the program was changed since
+    [[nodiscard]] const DesignFacts *get_design_facts() const {
+        return facts_recorded ? &design_facts : nullptr;
+    }
+
+    // nested lists share open_stmts, each list is copied into the arena once it is complete
+    NodeList parse_stmt_list() {
+        size_t first = open_stmts.size();
         while (currentToken.type == TokenType::NAME
                || currentToken.type == TokenType::WHILE
                || currentToken.type == TokenType::CALL
                || currentToken.type == TokenType::IF
                 ) {
-            stmts.push_back(parse_stmt());
+            Node *stmt = parse_stmt();
+            open_stmts.push_back(stmt);
         }
+        size_t count = open_stmts.size() - first;
+        NodeList stmts(arena->copy_array(open_stmts.data() + first, count), count);
+        open_stmts.resize(first);
         return stmts;
     }
 
-    std::shared_ptr<Node> parse_stmt() {
+    Node *parse_stmt() {
         if (currentToken.type == TokenType::NAME) return parse_assign();
         if (currentToken.type == TokenType::WHILE) return parse_while();
         if (currentToken.type == TokenType::CALL) return parse_call();
@@ -406,10 +825,10 @@ public:
         return nullptr;
     }
 
-    std::shared_ptr<WhileStmt> parse_while() {
+    WhileStmt *parse_while() {
         eat_and_read_next_token(TokenType::WHILE);
 
-        std::string var_name = currentToken.value;
+        NameId var_name = names->intern(currentToken.value);
         size_t whileLine = lexer->get_line();
         eat_and_read_next_token(TokenType::NAME);
         eat_and_read_next_token(TokenType::LBRACE);
@@ -421,15 +840,19 @@ public:
         }
 
         eat_and_read_next_token(TokenType::RBRACE);
-        auto while_stmt = std::make_shared<WhileStmt>(var_name, stmt_list);
+        auto while_stmt = arena->make<WhileStmt>(var_name, stmt_list);
         while_stmt->mLineNumber = whileLine;
+        if (facts != nullptr) {
+            facts->add_stmt_list(while_stmt, stmt_list);
+            facts->uses.push_back(while_stmt);
+        }
 
         return while_stmt;
     }
 
-    std::shared_ptr<Node> parse_if() {
+    Node *parse_if() {
         eat_and_read_next_token(TokenType::IF);
-        std::string var_name = currentToken.value;
+        NameId var_name = names->intern(currentToken.value);
         size_t ifLine = lexer->get_line();
         eat_and_read_next_token(TokenType::NAME);
 
@@ -443,15 +866,20 @@ public:
         auto else_stmts = parse_stmt_list();
         eat_and_read_next_token(TokenType::RBRACE);
 
-        auto ifStmt = std::make_shared<IfStmt>(var_name, then_stmts, else_stmts);
+        auto ifStmt = arena->make<IfStmt>(var_name, then_stmts, else_stmts);
         ifStmt->mLineNumber = ifLine;
+        if (facts != nullptr) {
+            facts->add_stmt_list(ifStmt, then_stmts);
+            facts->add_stmt_list(ifStmt, else_stmts, then_stmts.empty() ? nullptr : then_stmts[then_stmts.size() - 1]);
+            facts->uses.push_back(ifStmt);
+        }
 
         return ifStmt;
     }
 
 
-    std::shared_ptr<Assign> parse_assign() {
-        std::string var_name = currentToken.value;
+    Assign *parse_assign() {
+        NameId var_name = names->intern(currentToken.value);
         eat_and_read_next_token(TokenType::NAME);
         size_t assignLine = lexer->get_line();
 
@@ -460,20 +888,23 @@ public:
 
         eat_and_read_next_token(TokenType::SEMICOLON);
 
-        auto assignStmt = std::make_shared<Assign>(var_name, expr);
+        auto assignStmt = arena->make<Assign>(var_name, expr);
         assignStmt->mLineNumber = assignLine;
+        if (facts != nullptr) {
+            facts->modifies.push_back(assignStmt);
+            facts->uses.push_back(assignStmt);
+        }
 
         return assignStmt;
     }
 
-    std::shared_ptr<Node> parse_expr() {
+    Node *parse_expr() {
         if (!initialized) {
             return nullptr;
         }
 
         size_t exprLine = lexer->get_line();
-        auto left = parse_factor();
-        left ->mLineNumber = exprLine;
+        Node *left = parse_factor();
 
         while (currentToken.type == TokenType::PLUS || currentToken.type == TokenType::MINUS ||
                currentToken.type == TokenType::TIMES) {
@@ -492,13 +923,12 @@ public:
             }
 
             auto right = parse_factor();
-            left = std::make_shared<Expr>(left, op, right);
-            left->mLineNumber = exprLine;
+            left = exprs->expr(*arena, left, op, right, exprLine);
         }
         return left;
     }
 
-    std::shared_ptr<Node> parse_factor() {
+    Node *parse_factor() {
         if (!initialized) {
             return nullptr;
         }
@@ -511,57 +941,49 @@ public:
         }
 
         if (currentToken.type == TokenType::NAME) {
-            std::string value = currentToken.value;
+            std::string_view value = currentToken.value;
             size_t nameLine = lexer->get_line();
             if (!simple_semantic_utils::verify_name(value)) {
-                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Invalid variable name " + value);
+                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Invalid variable name " + std::string(value));
                 return nullptr;
             }
 
+            NameId id = names->intern(value);
             eat_and_read_next_token(TokenType::NAME);
 
-            auto factor = std::make_shared<Factor>(value);
-            factor->mLineNumber = nameLine;
-            return factor;
+            return exprs->factor(*arena, id, nameLine);
         }
         if (currentToken.type == TokenType::INTEGER) {
-            std::string value = currentToken.value;
+            std::string_view value = currentToken.value;
             size_t integerLine = lexer->get_line();
             if (!simple_semantic_utils::verify_integer(value)) {
-                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Invalid integer value " + value);
+                fatal_error(__PRETTY_FUNCTION__, __LINE__, "Invalid integer value " + std::string(value));
                 return nullptr;
             }
 
+            NameId id = names->intern(value);
             eat_and_read_next_token(TokenType::INTEGER);
 
-            auto factor = std::make_shared<Factor>(value);
-            factor->mLineNumber = integerLine;
-            return factor;
+            return exprs->factor(*arena, id, integerLine);
         }
 
         fatal_error(__PRETTY_FUNCTION__, __LINE__, "Unexpected token " + currentToken.to_string());
         return nullptr;
     }
 
-    std::shared_ptr<Call> parse_call() {
+    Call *parse_call() {
         eat_and_read_next_token(TokenType::CALL);
 
-        std::string proc_name = currentToken.value;
+        NameId proc_name = names->intern(currentToken.value);
         eat_and_read_next_token(TokenType::NAME);
         eat_and_read_next_token(TokenType::SEMICOLON);
 
-        auto call_node = std::make_shared<Call>(proc_name);
+        auto call_node = arena->make<Call>(proc_name);
         call_node->mLineNumber = lexer->get_line();
 
-        // created dummy procedure for now, since parsing procedures is done after parsing calls prob
-        // auto proc = std::make_shared<Procedure>("Dummy");
-        // call_node->procedure = proc;
-
-        auto it = procedures.find(proc_name);
-        if (it != procedures.end()) {
-            call_node->procedure = it->second;
-        } else {
-            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Call to undefined procedure: " + proc_name);
+        unresolved_calls.push_back(call_node);
+        if (facts != nullptr) {
+            facts->calls.push_back(call_node);
         }
 
         return call_node;
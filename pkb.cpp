@@ -1,5 +1,7 @@
 #include "pkb.h"
 
+TNodeTable TNodeTable::table;
+
 std::shared_ptr<std::vector<std::pair<TNode, TNode>>> PKB::usesRelations = std::make_shared<std::vector<std::pair<TNode, TNode>>>();
 std::shared_ptr<std::vector<std::pair<TNode, TNode>>> PKB::modifiesRelations = std::make_shared<std::vector<std::pair<TNode, TNode>>>();
 std::shared_ptr<std::vector<std::pair<TNode, TNode>>> PKB::followsTRelations = std::make_shared<std::vector<std::pair<TNode, TNode>>>();
@@ -12,7 +14,9 @@ std::shared_ptr<std::vector<std::pair<TNode, TNode>>> PKB::nextRelations = std::
 std::shared_ptr<std::vector<std::pair<TNode, TNode>>> PKB::nextTRelations = std::make_shared<std::vector<std::pair<TNode, TNode>>>();
 
 void pkb::test() {
-    for (auto relation : *PKB::usesRelations) {
-
+    std::cout << "Uses" << std::endl;
+    for (const auto &[left, right]: *PKB::usesRelations) {
+        std::cout << "(" << PKB::get_reference(left) << ": " << right.to_string() << "), ";
     }
+    std::cout << std::endl;
 }
\ No newline at end of file
@@ -3,7 +3,11 @@
 #define MINISPA_PKB_H
 
 #include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
+#include <numeric>
 #include <vector>
 
 #include "benchmark_tool.h"
@@ -14,11 +18,14 @@
 
 //#include "nodes.h"
 #include <array>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "parser.h"
+#include "call_graph.h"
+#include "thread_pool.h"
 
-enum TNode_type : int {
+enum TNode_type : uint8_t {
     TN_PROCEDURE,
     TN_WHILE,
     TN_ASSIGN,
@@ -28,107 +35,293 @@ enum TNode_type : int {
     TN_IF
 };
 
+using TNodeId = uint32_t;
+
+// set of TNode types, one bit per type
+using TNodeTypeMask = uint32_t;
+
+constexpr TNodeTypeMask type_mask(std::initializer_list<TNode_type> types) {
+    TNodeTypeMask mask = 0;
+    for (TNode_type type: types) {
+        mask |= TNodeTypeMask{1} << type;
+    }
+    return mask;
+}
+
+constexpr bool has_type(TNodeTypeMask mask, TNode_type type) {
+    return (mask >> type) & 1;
+}
+
+// The AST as seen by the PKB, mirrored into flat arrays indexed by a dense TNodeId.
+// Each attribute has its own array, so walks touch only the links they follow.
+class TNodeTable {
+public:
+    static constexpr TNodeId NONE = UINT32_MAX;
+
+    std::vector<Node *> node;
+    std::vector<TNode_type> type;
+    std::vector<TNodeId> parent;
+    std::vector<TNodeId> first_child;
+    std::vector<TNodeId> right_sibling;
+    std::vector<TNodeId> left_sibling;
+    std::vector<int> command_no; // stmt#
+    std::vector<NameId> name;    // NameTable::NONE for nodes without a name
+    std::vector<size_t> line;    // source line of this occurrence, shared expression nodes have one per use
+
+    static TNodeTable &instance() {
+        return table;
+    }
+
+    TNodeId add(Node *ast_node) {
+        auto id = static_cast<TNodeId>(node.size());
+        resize(size() + 1);
+        set(id, ast_node);
+        return id;
+    }
+
+    // adds unlinked rows up to rows, each filled with set afterwards; threads may fill rows of their own
+    void resize(size_t rows) {
+        node.resize(rows, nullptr);
+        type.resize(rows, TN_FACTOR);
+        parent.resize(rows, NONE);
+        first_child.resize(rows, NONE);
+        right_sibling.resize(rows, NONE);
+        left_sibling.resize(rows, NONE);
+        command_no.resize(rows, 0);
+        name.resize(rows, NameTable::NONE);
+        line.resize(rows, 0);
+    }
+
+    // the row mirrors ast_node, links are set afterwards
+    void set(TNodeId id, Node *ast_node) {
+        node[id] = ast_node;
+        type[id] = type_of(ast_node);
+        name[id] = get_node_name(ast_node);
+        line[id] = ast_node->mLineNumber;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return node.size();
+    }
+
+    void clear() {
+        node.clear();
+        type.clear();
+        parent.clear();
+        first_child.clear();
+        right_sibling.clear();
+        left_sibling.clear();
+        command_no.clear();
+        name.clear();
+        line.clear();
+    }
+
+    static TNode_type type_of(Node *ast_node) {
+        switch (ast_node->kind) {
+            case NodeKind::PROCEDURE:
+                return TN_PROCEDURE;
+            case NodeKind::WHILE:
+                return TN_WHILE;
+            case NodeKind::ASSIGN:
+                return TN_ASSIGN;
+            case NodeKind::EXPR:
+                return TN_EXPRESSION;
+            case NodeKind::FACTOR:
+                return TN_FACTOR;
+            case NodeKind::CALL:
+                return TN_CALL;
+            case NodeKind::IF:
+                return TN_IF;
+        }
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Unknown node type.");
+        return TN_FACTOR;
+    }
+
+private:
+    static TNodeTable table;
+};
+
+// AST children of a node as the TNode tree sees them: up to two single nodes followed by
+// up to two statement lists, viewed in place so walking them does not allocate
+class ChildNodes {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Node *;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Node *const *;
+        using reference = Node *;
+
+        iterator(const ChildNodes *owner, size_t index) : owner(owner), index(index) {}
+
+        Node *operator*() const { return (*owner)[index]; }
+
+        iterator &operator++() {
+            ++index;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return index == other.index; }
+
+        bool operator!=(const iterator &other) const { return index != other.index; }
+
+    private:
+        const ChildNodes *owner;
+        size_t index;
+    };
+
+    void push_back(Node *node) {
+        heads[head_count++] = node;
+    }
+
+    void append(const NodeList &list) {
+        lists[list_count++] = list;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return head_count + lists[0].size() + lists[1].size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    Node *operator[](size_t index) const {
+        if (index < head_count) {
+            return heads[index];
+        }
+        index -= head_count;
+        if (index < lists[0].size()) {
+            return lists[0][index];
+        }
+        return lists[1][index - lists[0].size()];
+    }
+
+    [[nodiscard]] iterator begin() const { return {this, 0}; }
+
+    [[nodiscard]] iterator end() const { return {this, size()}; }
+
+private:
+    std::array<Node *, 2> heads{};
+    size_t head_count = 0;
+    std::array<NodeList, 2> lists{};
+    size_t list_count = 0;
+};
+
+// handle of one row of the TNodeTable, a default constructed TNode refers to no node
 class TNode {
 public:
-    explicit TNode(std::shared_ptr<Node> node) {
-        this->node = std::move(node);
-        this->set_tnode_type();
+    explicit TNode(TNodeId id = TNodeTable::NONE) : id(id) {}
+
+    // new row for node, links are set afterwards
+    static TNode add(Node *node) {
+        return TNode(TNodeTable::instance().add(node));
+    }
+
+    [[nodiscard]] TNodeId get_id() const {
+        return id;
+    }
+
+    explicit operator bool() const {
+        return id != TNodeTable::NONE;
+    }
+
+    bool operator==(const TNode &other) const {
+        return id == other.id;
+    }
+
+    bool operator!=(const TNode &other) const {
+        return id != other.id;
     }
 
     [[nodiscard]] std::string to_string() const {
-        return node->to_string();
+        return get_node()->to_string();
+    }
+
+    [[nodiscard]] Node *get_node() const {
+        return TNodeTable::instance().node[id];
     }
 
-    [[nodiscard]] std::shared_ptr<Node> get_node() const {
-        return node;
+    [[nodiscard]] NameId get_name() const {
+        return TNodeTable::instance().name[id];
     }
 
     [[nodiscard]] int get_command_no() const {
-        return mCommand_no;
+        return TNodeTable::instance().command_no[id];
     }
 
     void set_command_no(const int command_no) {
-        this->mCommand_no = command_no;
+        TNodeTable::instance().command_no[id] = command_no;
     }
 
-    [[nodiscard]] std::shared_ptr<TNode> get_first_child() const {
-        return first_child;
+    [[nodiscard]] size_t get_line() const {
+        return TNodeTable::instance().line[id];
     }
 
-    void set_first_child(const std::shared_ptr<TNode> &child) {
-        this->first_child = child;
+    void set_line(const size_t line) {
+        TNodeTable::instance().line[id] = line;
     }
 
-    [[nodiscard]] std::shared_ptr<TNode> get_right_sibling() const {
-        return right_sibling;
+    [[nodiscard]] TNode get_first_child() const {
+        return TNode(TNodeTable::instance().first_child[id]);
     }
 
-    void set_right_sibling(const std::shared_ptr<TNode> &sibling) {
-        this->right_sibling = sibling;
+    void set_first_child(const TNode child) {
+        TNodeTable::instance().first_child[id] = child.id;
     }
 
-    [[nodiscard]] std::shared_ptr<TNode> get_parent() const {
-        return parent;
+    [[nodiscard]] TNode get_right_sibling() const {
+        return TNode(TNodeTable::instance().right_sibling[id]);
     }
 
-    void set_parent(const std::shared_ptr<TNode> &parent) {
-        this->parent = parent;
+    void set_right_sibling(const TNode sibling) {
+        TNodeTable::instance().right_sibling[id] = sibling.id;
     }
 
-    [[nodiscard]] std::shared_ptr<TNode> get_left_sibling() const {
-        return left_sibling;
+    [[nodiscard]] TNode get_parent() const {
+        return TNode(TNodeTable::instance().parent[id]);
     }
 
-    void set_left_sibling(const std::shared_ptr<TNode> &left_sibling) {
-        this->left_sibling = left_sibling;
+    void set_parent(const TNode parent) {
+        TNodeTable::instance().parent[id] = parent.id;
     }
 
-    [[nodiscard]] TNode_type get_tnode_type() const {
-        return type;
+    [[nodiscard]] TNode get_left_sibling() const {
+        return TNode(TNodeTable::instance().left_sibling[id]);
     }
 
-    void set_tnode_type() {
-        if (std::dynamic_pointer_cast<Procedure>(node)) {
-            type = TN_PROCEDURE;
-        } else if (std::dynamic_pointer_cast<WhileStmt>(node)) {
-            type = TN_WHILE;
-        } else if (std::dynamic_pointer_cast<Assign>(node)) {
-            type = TN_ASSIGN;
-        } else if (std::dynamic_pointer_cast<Expr>(node)) {
-            type = TN_EXPRESSION;
-        } else if (std::dynamic_pointer_cast<Factor>(node)) {
-            type = TN_FACTOR;
-        } else if (std::dynamic_pointer_cast<Call>(node)) {
-            type = TN_CALL;
-        } else if (std::dynamic_pointer_cast<IfStmt>(node)) {
-            type = TN_IF;
-        }
-        else {
-            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Unknown node type.");
-        }
+    void set_left_sibling(const TNode left_sibling) {
+        TNodeTable::instance().left_sibling[id] = left_sibling.id;
     }
 
-    static bool can_have_stmt_list(const std::shared_ptr<TNode> &node) {
+    [[nodiscard]] TNode_type get_tnode_type() const {
+        return TNodeTable::instance().type[id];
+    }
+
+    static bool can_have_stmt_list(const TNode node) {
         static const std::unordered_set allowedTypes = {
            TN_IF, TN_WHILE, TN_PROCEDURE
         };
 
-        if (allowedTypes.count(node->get_tnode_type()))
+        if (allowedTypes.count(node.get_tnode_type()))
             return true;
         return false;
     }
 
-    [[nodiscard]] std::vector<std::shared_ptr<Node>> get_stmt_list() const {
-        // casting Node to see if it's subclass that has stmt_list
-        if (auto procedure = std::dynamic_pointer_cast<Procedure>(node)) {
-            return procedure->stmt_list;
-        } else if (auto whileStmt = std::dynamic_pointer_cast<WhileStmt>(node)) {
-            return whileStmt->stmt_list;
-        } else if (auto ifStmt = std::dynamic_pointer_cast<IfStmt>(node)) {
-            std::vector<std::shared_ptr<Node>> result;
-            result.reserve( ifStmt->then_stmt_list.size() + ifStmt->else_stmt_list.size() );
-            result.insert( result.end(), ifStmt->then_stmt_list.begin(), ifStmt->then_stmt_list.end() );
-            result.insert( result.end(), ifStmt->else_stmt_list.begin(), ifStmt->else_stmt_list.end() );
+    // then and else statements follow each other for an if
+    [[nodiscard]] ChildNodes get_stmt_list() const {
+        ChildNodes result;
+        // checking the node kind to see if it's subclass that has stmt_list
+        if (auto procedure = node_cast<Procedure>(get_node())) {
+            result.append(procedure->stmt_list);
+            return result;
+        } else if (auto whileStmt = node_cast<WhileStmt>(get_node())) {
+            result.append(whileStmt->stmt_list);
+            return result;
+        } else if (auto ifStmt = node_cast<IfStmt>(get_node())) {
+            result.append(ifStmt->then_stmt_list);
+            result.append(ifStmt->else_stmt_list);
             return result;
         } else {
             fatal_error(__PRETTY_FUNCTION__, __LINE__,
@@ -138,13 +331,96 @@ public:
     }
 
 private:
-    std::shared_ptr<Node> node;
-    std::shared_ptr<TNode> first_child;
-    std::shared_ptr<TNode> right_sibling;
-    std::shared_ptr<TNode> parent;
-    std::shared_ptr<TNode> left_sibling;
-    TNode_type type;
-    int mCommand_no = 0;
+    TNodeId id;
+};
+
+// children of a TNode in order, followed through the sibling links without building a list
+class TNodeChildren {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TNode *;
+        using reference = TNode;
+
+        explicit iterator(TNodeId id) : id(id) {}
+
+        TNode operator*() const { return TNode(id); }
+
+        iterator &operator++() {
+            id = TNodeTable::instance().right_sibling[id];
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return id == other.id; }
+
+        bool operator!=(const iterator &other) const { return id != other.id; }
+
+    private:
+        TNodeId id;
+    };
+
+    explicit TNodeChildren(const TNode parent) : first(TNodeTable::instance().first_child[parent.get_id()]) {}
+
+    [[nodiscard]] iterator begin() const { return iterator(first); }
+
+    [[nodiscard]] iterator end() const { return iterator(TNodeTable::NONE); }
+
+    [[nodiscard]] bool empty() const {
+        return first == TNodeTable::NONE;
+    }
+
+private:
+    TNodeId first;
+};
+
+// TNodes stored back to back in an array, see PKB::get_followers
+class TNodeSlice {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = TNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TNode *;
+        using reference = TNode;
+
+        explicit iterator(const TNodeId *id) : id(id) {}
+
+        TNode operator*() const { return TNode(*id); }
+
+        iterator &operator++() {
+            ++id;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return id == other.id; }
+
+        bool operator!=(const iterator &other) const { return id != other.id; }
+
+    private:
+        const TNodeId *id;
+    };
+
+    TNodeSlice(const TNodeId *first, const TNodeId *last) : first(first), last(last) {}
+
+    [[nodiscard]] iterator begin() const { return iterator(first); }
+
+    [[nodiscard]] iterator end() const { return iterator(last); }
+
+    [[nodiscard]] size_t size() const {
+        return static_cast<size_t>(last - first);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return first == last;
+    }
+
+private:
+    const TNodeId *first;
+    const TNodeId *last;
 };
 
 class PKB {
@@ -173,58 +449,512 @@ public:
 
 
     //getter for ast
-    [[nodiscard]] std::vector<std::shared_ptr<TNode>> get_root_nodes() const {
+    [[nodiscard]] std::vector<TNode> get_root_nodes() const {
         return root_nodes;
     }
 
+    [[nodiscard]] size_t get_stmt_count() const {
+        return stmt_tnode.size() - 1;
+    }
+
+    // statement numbered stmt_no, a TNode referring to no node if there is none
+    [[nodiscard]] TNode get_stmt(size_t stmt_no) const {
+        return stmt_no < stmt_tnode.size() ? TNode(stmt_tnode[stmt_no]) : TNode();
+    }
+
+    [[nodiscard]] TNode_type get_stmt_type(size_t stmt_no) const {
+        return stmt_type[stmt_no];
+    }
+
+    // root TNode of the procedure the statement is in
+    [[nodiscard]] TNode get_stmt_procedure(size_t stmt_no) const {
+        return TNode(stmt_procedure[stmt_no]);
+    }
+
+    // calls between procedures, vertex v is the procedure of get_root_nodes()[v]
+    [[nodiscard]] const CallGraph &get_call_graph() const {
+        return call_graph;
+    }
+
+    [[nodiscard]] CallGraph::Vertex get_procedure_vertex(const TNode root) const {
+        auto it = procedure_vertex.find(root.get_id());
+        return it != procedure_vertex.end() ? it->second : CallGraph::NONE;
+    }
+
+    // Parent* pairs grow with the square of the nesting depth, when they are not stored parentTRelations stays
+    // empty and queries enumerate them with get_parent_star_pairs instead; takes effect on the next build
+    void set_parent_star_materialized(bool materialized) {
+        materialize_parent_star = materialized;
+    }
+
+    // whether the last build stored the Parent* pairs, which stays so until the next build whatever is set meanwhile
+    [[nodiscard]] bool is_parent_star_materialized() const {
+        return parent_star_stored;
+    }
+
+    // rows [first, end) of node and its descendants within its procedure, the table is laid out in preorder;
+    // the bodies of procedures called from there are rows of their own and not part of the range
+    [[nodiscard]] std::pair<TNodeId, TNodeId> get_subtree(const TNode node) const {
+        return {node.get_id(), subtree_exit[node.get_id()]};
+    }
+
+    // appends the statements and procedures node1 is Parent* of, in the order parentTRelations lists them:
+    // its subtree and the procedures called from there, directly or not
+    void get_parent_star_targets(const TNode node1, std::vector<TNode> &targets) const {
+        constexpr TNodeTypeMask stmts_and_procedures =
+                type_mask({TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        const auto &table = TNodeTable::instance();
+        const TNodeId id1 = node1.get_id();
+        IdSet marks;
+        std::vector<CallGraph::Vertex> called;
+        add_called_procedures(id1, called, marks);
+        add_called_closure(called, marks);
+
+        std::vector<TNodeId> rows;
+        auto scan = [&](const std::pair<TNodeId, TNodeId> subtree) {
+            for (TNodeId row = subtree.first; row < subtree.second; ++row) {
+                if (row != id1 && has_type(stmts_and_procedures, table.type[row])) {
+                    rows.push_back(row);
+                }
+            }
+        };
+        if (!marks.contains(row_vertex[id1])) {
+            scan(get_subtree(node1));
+        }
+        for (CallGraph::Vertex procedure: called) {
+            scan(get_subtree(root_nodes[procedure]));
+        }
+        std::sort(rows.begin(), rows.end(), [this](TNodeId a, TNodeId b) {
+            return list_position[a] < list_position[b];
+        });
+        for (TNodeId row: rows) {
+            targets.emplace_back(row);
+        }
+    }
+
+    // appends the Parent* pairs in the order parentTRelations lists them, only those starting at node1 and those
+    // ending at node2 when they refer to a node
+    void get_parent_star_pairs(const TNode node1, const TNode node2,
+                               std::vector<std::pair<TNode, TNode>> &pairs) const {
+        constexpr TNodeTypeMask stmts_and_procedures =
+                type_mask({TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        std::vector<TNode> targets;
+        auto add_pairs = [&](const TNode source) {
+            if (!has_type(stmts_and_procedures, source.get_tnode_type())) {
+                return;
+            }
+            if (node2) {
+                if (source != node2 && has_type(stmts_and_procedures, node2.get_tnode_type()) &&
+                    parentT(source, node2)) {
+                    pairs.emplace_back(source, node2);
+                }
+                return;
+            }
+            targets.clear();
+            get_parent_star_targets(source, targets);
+            for (const TNode target: targets) {
+                pairs.emplace_back(source, target);
+            }
+        };
+        if (node1) {
+            add_pairs(node1);
+            return;
+        }
+        for (const TNode source: tnode_list) {
+            add_pairs(source);
+        }
+    }
+
+    // number of Parent* pairs, counted once per build when they are not stored
+    size_t get_parent_star_size() {
+        if (parent_star_stored) {
+            return parentTRelations->size();
+        }
+        if (parent_star_total == SIZE_MAX) {
+            constexpr TNodeTypeMask stmts_and_procedures =
+                    type_mask({TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+            parent_star_total = 0;
+            std::vector<TNode> targets;
+            for (const TNode source: tnode_list) {
+                if (has_type(stmts_and_procedures, source.get_tnode_type())) {
+                    targets.clear();
+                    get_parent_star_targets(source, targets);
+                    parent_star_total += targets.size();
+                }
+            }
+        }
+        return parent_star_total;
+    }
+
+    // statements after node in its statement list, the ones it is Follows* of
+    [[nodiscard]] TNodeSlice get_followers(const TNode node) const {
+        const TNodeId list = stmt_list[node.get_id()];
+        if (list == TNodeTable::NONE) {
+            return {nullptr, nullptr};
+        }
+        return {list_stmts.data() + stmt_slot[node.get_id()] + 1, list_stmts.data() + list_end[list]};
+    }
+
+    // Follows* pairs grow with the square of the statement list lengths, when they are not stored
+    // followsTRelations stays empty and queries enumerate them with get_follows_star_pairs instead;
+    // takes effect on the next build
+    void set_follows_star_materialized(bool materialized) {
+        materialize_follows_star = materialized;
+    }
+
+    // whether the last build stored the Follows* pairs, see is_parent_star_materialized
+    [[nodiscard]] bool is_follows_star_materialized() const {
+        return follows_star_stored;
+    }
+
+    // appends the Follows* pairs in the order followsTRelations lists them, only those starting at node1 and those
+    // ending at node2 when they refer to a node
+    void get_follows_star_pairs(const TNode node1, const TNode node2,
+                                std::vector<std::pair<TNode, TNode>> &pairs) const {
+        auto by_position = [this](TNodeId a, TNodeId b) {
+            return list_position[a] < list_position[b];
+        };
+        std::vector<TNodeId> rows;
+        if (node1) {
+            if (stmt_list[node1.get_id()] == TNodeTable::NONE) {
+                return;
+            }
+            if (node2) {
+                if (stmt_list[node2.get_id()] != TNodeTable::NONE && followsT(node1, node2)) {
+                    pairs.emplace_back(node1, node2);
+                }
+                return;
+            }
+            const TNodeSlice followers = get_followers(node1);
+            for (const TNode follower: followers) {
+                rows.push_back(follower.get_id());
+            }
+            std::sort(rows.begin(), rows.end(), by_position);
+            for (TNodeId row: rows) {
+                pairs.emplace_back(node1, TNode(row));
+            }
+            return;
+        }
+        if (node2) {
+            // the statements before node2 in its list
+            const TNodeId list = stmt_list[node2.get_id()];
+            if (list == TNodeTable::NONE) {
+                return;
+            }
+            rows.assign(list_stmts.begin() + list_begin[list], list_stmts.begin() + stmt_slot[node2.get_id()]);
+            std::sort(rows.begin(), rows.end(), by_position);
+            for (TNodeId row: rows) {
+                pairs.emplace_back(TNode(row), node2);
+            }
+            return;
+        }
+        for (const TNode source: tnode_list) {
+            if (stmt_list[source.get_id()] != TNodeTable::NONE) {
+                get_follows_star_pairs(source, TNode(), pairs);
+            }
+        }
+    }
+
+    // number of Follows* pairs: every statement of a list follows each one before it
+    [[nodiscard]] size_t get_follows_star_size() const {
+        if (follows_star_stored) {
+            return followsTRelations->size();
+        }
+        size_t pairs = 0;
+        for (size_t list = 0; list < list_end.size(); ++list) {
+            const size_t length = list_end[list] - list_begin[list];
+            pairs += length * (length - 1) / 2;
+        }
+        return pairs;
+    }
+
+    // appends the pairs of a stored relation vector, one of parentRelations ... nextTRelations, that start at node1
+    // and end at node2, at least one of them referring to a node; in the order the vector lists them. The pairs are
+    // found through an index of the vector by node rather than by scanning it
+    void get_relation_pairs(const std::vector<std::pair<TNode, TNode>> &relations, const TNode node1,
+                            const TNode node2, std::vector<std::pair<TNode, TNode>> &pairs) {
+        const auto families = relation_families();
+        const auto family = static_cast<size_t>(std::find_if(families.begin(), families.end(), [&](const auto &f) {
+            return f.get() == &relations;
+        }) - families.begin());
+        if (family == RELATION_FAMILIES) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Not a relation vector of the PKB.");
+            return;
+        }
+        // the side given, the other one is checked on each pair
+        const bool by_left = static_cast<bool>(node1);
+        const TNodeId id = by_left ? node1.get_id() : node2.get_id();
+        const auto &lists = relation_index(family, by_left ? 0 : 1);
+        for (const size_t *i = lists.begin(id); i != lists.end(id); ++i) {
+            if (!by_left || !node2 || relations[*i].second == node2) {
+                pairs.push_back(relations[*i]);
+            }
+        }
+    }
+
+    // how a query refers to a node: stmt# for statements, the name for procedures, variables and constants
+    static std::string get_reference(const TNode node) {
+        if (is_statement(node)) {
+            return std::to_string(node.get_command_no());
+        }
+        return node.get_name() == NameTable::NONE ? std::string() : NameTable::instance().name(node.get_name());
+    }
+
+    // whether two nodes are the same thing to a query: the same stmt#, or the same name for other nodes
+    static bool same_reference(const TNode node1, const TNode node2) {
+        if (is_statement(node1) || is_statement(node2)) {
+            return is_statement(node1) && is_statement(node2) && node1.get_command_no() == node2.get_command_no();
+        }
+        return node1.get_name() != NameTable::NONE && node1.get_name() == node2.get_name();
+    }
+
+    // number of threads initialize and update_procedure may extract relations on, 0 = one per core. The threads
+    // are started here and kept for every later build
+    void set_build_threads(size_t threads) {
+        pool.resize(threads);
+    }
+
     void initialize() {
         this->build_AST();
         this->build_pkb_relations();
     }
 
-    static std::vector<std::shared_ptr<Node>> get_tnode_children_as_node(const std::shared_ptr<TNode> &TNode) {
-        std::vector<std::shared_ptr<Node>> children;
-        switch (TNode->get_tnode_type()) {
+    // reparses one procedure from code, see Parser::replace_procedure, and patches the TNode tree and the
+    // relations instead of rebuilding them. The new body is appended to the table and the rows of the old one are
+    // left dead; only the relations starting in the procedure or in a procedure calling it, directly or not, are
+    // recomputed, from the design facts of the new body. TNode ids are not stable across an update: the procedure
+    // gets a new root and new rows, and the recomputed pairs are appended to the relation vectors, so these list
+    // the same pairs as a full build in another order. stmt# are the ones a full build gives. When the procedure and
+    // its callers make up more than half of the table, or dead rows would, the whole table is built again instead
+    void update_procedure(const std::string &code) {
+        Procedure *procedure = Parser::instance().replace_procedure(code);
+        auto &table = TNodeTable::instance();
+        const TNode old_root = find_node_in_roots(procedure);
+        const TNodeId old_first = old_root.get_id() + 1;
+        const TNodeId old_exit = subtree_exit[old_root.get_id()];
+        const CallGraph::Vertex edited = procedure_vertex.at(old_root.get_id());
+
+        // procedures whose relations can see the body: the edited one and its callers, using the old call graph
+        // as only the edited procedure's own calls change
+        std::vector<char> affected(root_nodes.size(), 0);
+        std::vector<CallGraph::Vertex> affected_procedures{edited};
+        affected[edited] = 1;
+        for (size_t i = 0; i < affected_procedures.size(); ++i) {
+            for (CallGraph::Vertex caller: call_graph.callers(affected_procedures[i])) {
+                if (!affected[caller]) {
+                    affected[caller] = 1;
+                    affected_procedures.push_back(caller);
+                }
+            }
+        }
+        // past half of the table, re-emitting the relations of the affected procedures and patching costs more than
+        // building everything again (see the incremental_update benchmark); so do dead rows past half of the table
+        size_t affected_rows = 0;
+        for (CallGraph::Vertex vertex: affected_procedures) {
+            affected_rows += subtree_exit[root_nodes[vertex].get_id()] - root_nodes[vertex].get_id();
+        }
+        if (2 * affected_rows > table.size() - dead_rows ||
+            2 * (dead_rows + old_exit - old_root.get_id()) > table.size()) {
+            initialize();
+            return;
+        }
+        // a pair ending in the old body starts in an affected procedure too
+        for (const auto &relations: relation_families()) {
+            relations->erase(std::remove_if(relations->begin(), relations->end(), [&](const auto &relation) {
+                return affected[row_vertex[relation.first.get_id()]];
+            }), relations->end());
+        }
+
+        // the old body leaves tnode_list, its statement lists are emptied and its calls dropped
+        if (old_first < old_exit) {
+            const auto body = std::lower_bound(
+                    tnode_list.begin() + static_cast<std::ptrdiff_t>(root_nodes.size()), tnode_list.end(),
+                    list_position[old_first], [this](const TNode tnode, const TNodeId position) {
+                        return list_position[tnode.get_id()] < position;
+                    });
+            tnode_list.erase(body, body + (old_exit - old_first));
+        }
+        for (TNodeId row = old_first; row < old_exit; ++row) {
+            if (stmt_list[row] != TNodeTable::NONE) {
+                list_end[stmt_list[row]] = list_begin[stmt_list[row]];
+                stmt_list[row] = TNodeTable::NONE;
+            }
+        }
+        call_rows.erase(std::lower_bound(call_rows.begin(), call_rows.end(), old_first),
+                        std::lower_bound(call_rows.begin(), call_rows.end(), old_exit));
+        dead_rows += old_exit - old_root.get_id();
+
+        // the new root takes the old one's place among the roots, its body goes after every other row
+        TNodeId position = list_position[tnode_list.back().get_id()] + 1;
+        const auto first = static_cast<TNodeId>(table.size());
+        const TNode root(first);
+        table.resize(first + count_tnodes(TN_PROCEDURE, procedure));
+        add_procedure_rows(procedure, first);
+        root_nodes[edited] = root;
+        root_index[procedure] = root;
+        procedure_vertex.erase(old_root.get_id());
+        procedure_vertex.emplace(root.get_id(), edited);
+        tnode_list[edited] = root;
+        for (TNodeId row = first + 1; row < table.size(); ++row) {
+            tnode_list.emplace_back(row);
+        }
+        label_tnodes(first);
+        list_position[first] = list_position[old_root.get_id()];
+        for (TNodeId row = first + 1; row < table.size(); ++row) {
+            list_position[row] = position++;
+        }
+        index_stmt_lists(first);
+
+        // calls to the procedure go to the new root, the calls of the new body are bound and become its edges in
+        // the call graph
+        auto calls_of = [this](const CallGraph::Vertex vertex) {
+            const TNodeId begin = root_nodes[vertex].get_id();
+            const auto call = std::lower_bound(call_rows.begin(), call_rows.end(), begin);
+            return std::make_pair(call, std::lower_bound(call, call_rows.end(), subtree_exit[begin]));
+        };
+        for (CallGraph::Vertex caller: call_graph.callers(edited)) {
+            for (auto [call, last] = calls_of(caller); call != last; ++call) {
+                if (table.first_child[*call] == old_root.get_id()) {
+                    TNode(*call).set_first_child(root);
+                }
+            }
+        }
+        std::vector<CallGraph::Vertex> relinked = call_graph.callees(edited);
+        std::vector<CallGraph::Vertex> callees;
+        for (TNodeId id: procedure_nodes(root)) {
+            if (table.type[id] == TN_CALL) {
+                link_call(TNode(id));
+                callees.push_back(procedure_vertex.at(table.first_child[id]));
+            }
+        }
+        call_graph.set_callees(edited, callees);
+        call_graph.finalize(pool);
+        // a root's parent is the last call to it in tnode_list, see add_procedures
+        relinked.insert(relinked.end(), callees.begin(), callees.end());
+        relinked.push_back(edited);
+        for (CallGraph::Vertex callee: relinked) {
+            TNode parent;
+            for (CallGraph::Vertex caller: call_graph.callers(callee)) {
+                for (auto [call, last] = calls_of(caller); call != last; ++call) {
+                    if (table.first_child[*call] == root_nodes[callee].get_id() &&
+                        (!parent || list_position[*call] > list_position[parent.get_id()])) {
+                        parent = TNode(*call);
+                    }
+                }
+            }
+            root_nodes[callee].set_parent(parent);
+        }
+
+        // stmt# before the procedure's stay, the ones after them move by the change in its length. Statements are
+        // numbered in source order, so the procedure's go before those of the procedures after it in the source,
+        // also when its old body had none
+        const auto old_begin = std::partition_point(
+                stmt_procedure.begin() + 1, stmt_procedure.end(), [procedure](const TNodeId procedure_root) {
+                    return static_cast<Procedure *>(TNode(procedure_root).get_node())->source_index <
+                           procedure->source_index;
+                });
+        const auto old_end = std::find_if(old_begin, stmt_procedure.end(), [&old_root](TNodeId procedure_root) {
+            return procedure_root != old_root.get_id();
+        });
+        const auto begin = old_begin - stmt_procedure.begin();
+        const auto end = old_end - stmt_procedure.begin();
+        const std::vector<TNodeId> later_tnode(stmt_tnode.begin() + end, stmt_tnode.end());
+        const std::vector<TNode_type> later_type(stmt_type.begin() + end, stmt_type.end());
+        const std::vector<TNodeId> later_procedure(stmt_procedure.begin() + end, stmt_procedure.end());
+        const size_t statements = count_statements(root);
+        stmt_tnode.resize(begin + statements);
+        stmt_type.resize(begin + statements);
+        stmt_procedure.resize(begin + statements);
+        number_statements(root, begin);
+        for (size_t i = 0; i < later_tnode.size(); ++i) {
+            TNode(later_tnode[i]).set_command_no(static_cast<int>(stmt_tnode.size()));
+            stmt_tnode.push_back(later_tnode[i]);
+            stmt_type.push_back(later_type[i]);
+            stmt_procedure.push_back(later_procedure[i]);
+        }
+
+        DesignFacts facts;
+        facts.add_procedure(procedure);
+        index_design_facts(facts, first);
+        parent_star_total = SIZE_MAX;
+        drop_relation_indexes();
+
+        std::vector<TNode> sources;
+        for (CallGraph::Vertex vertex: affected_procedures) {
+            const TNodeId begin_row = root_nodes[vertex].get_id();
+            for (TNodeId row = begin_row; row < subtree_exit[begin_row]; ++row) {
+                sources.emplace_back(row);
+            }
+        }
+        std::sort(sources.begin(), sources.end(), [this](const TNode a, const TNode b) {
+            return list_position[a.get_id()] < list_position[b.get_id()];
+        });
+        add_relations(sources);
+    }
+
+    // mirrors the parsed program into the TNode table, replacing the previous one
+    void build_AST() {
+        if (!Parser::instance().initialized) {
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Parser is not initialized.");
+            return;
+        }
+
+        TNodeTable::instance().clear();
+        root_nodes.clear();
+        root_index.clear();
+        tnode_list.clear();
+        dead_rows = 0;
+        add_procedures(Parser::instance().get_all_procedures());
+        label_tnodes();
+        index_stmt_lists();
+        build_call_graph();
+        number_statements();
+    }
+
+    static ChildNodes get_tnode_children_as_node(const TNode tnode) {
+        return get_children_as_node(tnode.get_tnode_type(), tnode.get_node());
+    }
+
+    // children of an AST node as the TNode tree has them, type is the type of its row
+    static ChildNodes get_children_as_node(const TNode_type type, Node *node) {
+        ChildNodes children;
+        switch (type) {
             // returning called procedure
         case TN_CALL: {
-            children.push_back(std::dynamic_pointer_cast<Call>(TNode->get_node())->procedure);
+            children.push_back(static_cast<Call *>(node)->procedure);
             break;
         }
             // returning statement list
         case TN_PROCEDURE: {
-            children = std::dynamic_pointer_cast<Procedure>(TNode->get_node())->stmt_list;
+            children.append(static_cast<Procedure *>(node)->stmt_list);
             break;
         }
             // returning conditional variable and statement list
         case TN_WHILE: {
-            children.push_back(
-                    std::make_shared<Factor>(std::dynamic_pointer_cast<WhileStmt>(TNode->get_node())->var_name));
-            for (const auto &node: std::dynamic_pointer_cast<WhileStmt>(TNode->get_node())->stmt_list) {
-                children.push_back(node);
-            }
+            auto while_stmt = static_cast<WhileStmt *>(node);
+            children.push_back(instance().factor_for(while_stmt->var_name));
+            children.append(while_stmt->stmt_list);
             break;
         }
             // returning variable and expression
         case TN_ASSIGN: {
-            children.push_back(
-                    std::make_shared<Factor>(std::dynamic_pointer_cast<Assign>(TNode->get_node())->var_name));
-            children.push_back(std::dynamic_pointer_cast<Assign>(TNode->get_node())->expr);
+            auto assign = static_cast<Assign *>(node);
+            children.push_back(instance().factor_for(assign->var_name));
+            children.push_back(assign->expr);
             break;
         }
             // returning left and right piece of expression
         case TN_EXPRESSION: {
-            children.push_back(std::dynamic_pointer_cast<Expr>(TNode->get_node())->left);
-            children.push_back(std::dynamic_pointer_cast<Expr>(TNode->get_node())->right);
+            auto expr = static_cast<Expr *>(node);
+            children.push_back(expr->left);
+            children.push_back(expr->right);
             break;
         }
         case TN_IF: {
-            children.push_back(std::make_shared<Factor>(std::dynamic_pointer_cast<IfStmt>(TNode->get_node())->var_name));
-            for (const auto &node: std::dynamic_pointer_cast<IfStmt>(TNode->get_node())->then_stmt_list) {
-                children.push_back(node);
-            }
-            for (const auto &node: std::dynamic_pointer_cast<IfStmt>(TNode->get_node())->else_stmt_list) {
-                children.push_back(node);
-            }
+            auto if_stmt = static_cast<IfStmt *>(node);
+            children.push_back(instance().factor_for(if_stmt->var_name));
+            children.append(if_stmt->then_stmt_list);
+            children.append(if_stmt->else_stmt_list);
         }
             // factor can't have children, returning empty list
         case TN_FACTOR: {
@@ -234,116 +964,160 @@ public:
         return children;
     }
 
-    static std::vector<std::shared_ptr<TNode>> get_tnode_children(const std::shared_ptr<TNode> &tnode) {
-        std::vector<std::shared_ptr<TNode>> children;
-        if (tnode->get_first_child() != nullptr) {
-            children.push_back(tnode->get_first_child());
-            std::shared_ptr<TNode> current_child = tnode->get_first_child();
-            while (current_child->get_right_sibling() != nullptr) {
-                current_child = current_child->get_right_sibling();
-                children.push_back((current_child));
-            }
-        }
-
-        return children;
+    static TNodeChildren get_tnode_children(const TNode tnode) {
+        return TNodeChildren(tnode);
     }
 
-    // sets parent and sibling relations between TNodes
-    static void set_tnode_relations(const std::map<std::string, std::shared_ptr<Procedure>>& procedure_map) {
-        for (const auto& [name, proc_ptr] : procedure_map) {
-            auto new_root_node = std::make_shared<TNode>(proc_ptr);
+    // lays the procedures out in program order: as they appear in the source, each one's rows in preorder right
+    // after its root, so every subtree is one run of rows and walking it sweeps the columns front to back.
+    // root_nodes and tnode_list keep the order of procedure_map, tnode_list has the roots first, then the rows
+    // below each root in preorder. The rows of each procedure are counted on the pool, which gives every procedure
+    // its range of rows, then the procedures are laid out in their ranges on the pool
+    void add_procedures(const std::map<std::string, Procedure *> &procedure_map) {
+        auto &table = TNodeTable::instance();
+        std::vector<Procedure *> procedures;
+        for (const auto &[name, procedure]: procedure_map) {
+            procedures.push_back(procedure);
+        }
+        std::vector<size_t> source_order(procedures.size());
+        for (size_t i = 0; i < procedures.size(); ++i) {
+            source_order[i] = i;
+        }
+        std::sort(source_order.begin(), source_order.end(), [&procedures](size_t a, size_t b) {
+            return procedures[a]->source_index < procedures[b]->source_index;
+        });
 
-            instance().root_nodes.push_back(new_root_node);
-            instance().tnode_list.push_back(new_root_node);
+        // laying out then only reads factors
+        for (NameId name = 0; name < NameTable::instance().size(); ++name) {
+            factor_for(name);
+        }
+        std::vector<TNodeId> begin(procedures.size() + 1, 0); // rows of the k-th procedure in the source
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            begin[k + 1] = count_tnodes(TN_PROCEDURE, procedures[source_order[k]]);
+        });
+        std::partial_sum(begin.begin(), begin.end(), begin.begin());
+        table.resize(begin.back());
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            add_procedure_rows(procedures[source_order[k]], begin[k]);
+        });
+
+        root_nodes.resize(procedures.size());
+        std::vector<TNodeId> exits(procedures.size());
+        for (size_t k = 0; k < procedures.size(); ++k) {
+            const size_t i = source_order[k];
+            root_nodes[i] = TNode(begin[k]);
+            root_index.emplace(procedures[i], root_nodes[i]);
+            exits[i] = begin[k + 1];
+        }
+        tnode_list = root_nodes;
+        for (size_t i = 0; i < procedures.size(); ++i) {
+            for (TNodeId row = root_nodes[i].get_id() + 1; row < exits[i]; ++row) {
+                tnode_list.emplace_back(row);
+            }
         }
-        for (const auto& node : instance().root_nodes) {
-            set_tnode_children(node, get_tnode_children_as_node(node));
+        // every root exists now; a root's parent is the last call to it in tnode_list
+        for (const TNode tnode: tnode_list) {
+            if (table.type[tnode.get_id()] == TN_CALL) {
+                link_call(tnode);
+            }
         }
     }
 
-    static void set_tnode_children(const std::shared_ptr<TNode> &parent, std::vector<std::shared_ptr<Node>> children) {
-        if (children.empty()) { return; }
-        else if (children.size() == 1) {
-            std::shared_ptr<TNode> first_child;
-            if (std::dynamic_pointer_cast<Procedure>(children[0])) {
-                first_child = instance().find_node_in_roots(children[0]);
-            } else {
-                first_child = std::make_shared<TNode>(children[0]);
-                instance().tnode_list.push_back(first_child);
-            }
-            parent->set_first_child(first_child);
-            first_child->set_parent(parent);
-            if (first_child->get_tnode_type() != TN_PROCEDURE) {
-                // procedures are handled in set_tnode_relations
-                set_tnode_children(first_child, get_tnode_children_as_node(first_child));
+    // rows add_tnode_children lays out for the subtree of an AST node, its own included; type is its row's
+    static TNodeId count_tnodes(const TNode_type type, Node *node) {
+        TNodeId rows = 1;
+        if (type != TN_CALL) {
+            for (Node *child: get_children_as_node(type, node)) {
+                rows += count_tnodes(TNodeTable::type_of(child), child);
             }
-        } else {
-            std::shared_ptr<TNode> current_child;
-            std::shared_ptr<TNode> next_child;
-            if (std::dynamic_pointer_cast<Procedure>(children[0])) {
-                current_child = instance().find_node_in_roots(children[0]);
+        }
+        return rows;
+    }
+
+    // lays procedure out from row root on, in rows TNodeTable::resize made
+    static void add_procedure_rows(Procedure *procedure, const TNodeId root) {
+        TNodeTable::instance().set(root, procedure);
+        add_tnode_children(TNode(root), root + 1);
+    }
+
+    // lays the subtree below parent out in preorder from row next on and links it, returns the row after it.
+    // Calls are left without a child, see link_call, as the called procedure may not be laid out yet
+    static TNodeId add_tnode_children(TNode parent, TNodeId next) {
+        if (parent.get_tnode_type() == TN_CALL) {
+            return next;
+        }
+        TNode previous;
+        for (Node *child: get_tnode_children_as_node(parent)) {
+            TNode tnode = add_child_occurrence(parent, child, next);
+            tnode.set_parent(parent);
+            if (previous) {
+                previous.set_right_sibling(tnode);
+                tnode.set_left_sibling(previous);
             } else {
-                current_child = std::make_shared<TNode>(children[0]);
-            }
-            parent->set_first_child(current_child);
-            for (int i = 0; i < children.size() - 1; i++) { // executes loop for every child but last
-                if (std::dynamic_pointer_cast<Procedure>(children[i + 1])) {
-                    next_child = instance().find_node_in_roots(children[i + 1]);
-                } else {
-                    next_child = std::make_shared<TNode>(children[i + 1]);
-                    instance().tnode_list.push_back(current_child);
-                }
-                current_child->set_parent(parent);
-                current_child->set_right_sibling(next_child);
-                next_child->set_left_sibling(current_child);
-                if (current_child->get_tnode_type() != TN_PROCEDURE) {
-                    // procedures are handled in set_tnode_relations
-                    set_tnode_children(current_child, get_tnode_children_as_node(current_child));
-                }
-                current_child = next_child;
-            }
-            current_child->set_parent(parent);
-            if (current_child->get_tnode_type() != TN_PROCEDURE) {
-                // procedures are handled in set_tnode_relations
-                instance().tnode_list.push_back(current_child);
-                set_tnode_children(current_child, get_tnode_children_as_node(current_child));
+                parent.set_first_child(tnode);
             }
+            next = add_tnode_children(tnode, next + 1);
+            previous = tnode;
         }
+        return next;
     }
 
-    static std::vector<std::shared_ptr<TNode>> get_ast_as_list(const std::shared_ptr<TNode> &rootNode,
-                                                               const bool notRootFlag = false) {
-        std::vector<std::shared_ptr<TNode>> result;
-        if (notRootFlag == false) { result.push_back(rootNode); }
-        for (const auto &child: get_tnode_children(rootNode)) {
-            result.push_back(child);
-            auto tmp = get_ast_as_list(child, true);
-            result.insert(result.end(), tmp.begin(), tmp.end());
-        }
+    // the child of a call is the root of the called procedure, which takes the call as its parent
+    void link_call(TNode call) {
+        TNode called = find_node_in_roots(static_cast<Call *>(call.get_node())->procedure);
+        call.set_first_child(called);
+        called.set_parent(call);
+    }
 
-        return result;
+    // expression nodes are shared by every statement using them, so their row takes the line of the assignment
+    // this occurrence is in rather than the line the node was first parsed on
+    static TNode add_child_occurrence(const TNode parent, Node *child, const TNodeId row) {
+        TNodeTable::instance().set(row, child);
+        TNode tnode(row);
+        const TNode_type parent_type = parent.get_tnode_type();
+        if (parent_type == TN_EXPRESSION ||
+            (parent_type == TN_ASSIGN && child == static_cast<Assign *>(parent.get_node())->expr)) {
+            tnode.set_line(parent.get_line());
+        }
+        return tnode;
     }
 
-    static int assign_command_no(const std::vector<std::shared_ptr<TNode>> &nodes) {
-        for (auto node : nodes) {
-            node->set_command_no(1);
+    // preorder walk of the subtree, following calls into the called procedures
+    static std::vector<TNode> get_ast_as_list(const TNode rootNode, const bool notRootFlag = false) {
+        const auto &table = TNodeTable::instance();
+        std::vector<TNode> result;
+        if (notRootFlag == false) { result.push_back(rootNode); }
+
+        std::vector<TNodeId> pending; // right siblings still to visit, innermost last
+        TNodeId current = table.first_child[rootNode.get_id()];
+        while (current != TNodeTable::NONE || !pending.empty()) {
+            if (current == TNodeTable::NONE) {
+                current = pending.back();
+                pending.pop_back();
+            }
+            result.emplace_back(current);
+            if (table.right_sibling[current] != TNodeTable::NONE) {
+                pending.push_back(table.right_sibling[current]);
+            }
+            current = table.first_child[current];
         }
-        return 0;
+
+        return result;
     }
 
     // node relations
-    static bool is_statement(const std::shared_ptr<TNode> &node) {
+    static bool is_statement(const TNode node) {
         static const std::unordered_set allowedTypes = {
             TN_ASSIGN, TN_WHILE, TN_CALL, TN_IF
         };
 
-        if (allowedTypes.count(node->get_tnode_type()))
+        if (allowedTypes.count(node.get_tnode_type()))
             return true;
         return false;
     }
 
-    static bool parent(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node1->get_tnode_type() == TN_FACTOR) {
+    static bool parent(const TNode node1, const TNode node2) {
+        if (node1.get_tnode_type() == TN_FACTOR) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Factor node can't be a parent.");
         }
 
@@ -356,67 +1130,73 @@ public:
         return false;
     }
 
-    static bool parentT(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node1->get_tnode_type() == TN_FACTOR) {
+    static bool parentT(const TNode node1, const TNode node2) {
+        if (node1.get_tnode_type() == TN_FACTOR) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Factor node can't be a parent.");
         }
 
-        bool result = false;
-        for (const auto &child: get_tnode_children(node1)) {
-            if (child == node2) {
+        // node2 is in the subtree of node1 or in a procedure called from there, directly or not
+        const auto &pkb = PKB::instance();
+        const TNodeId id1 = node1.get_id();
+        const TNodeId id2 = node2.get_id();
+        if (id1 < id2 && id2 < pkb.subtree_exit[id1]) {
+            return true;
+        }
+        const CallGraph::Vertex procedure2 = pkb.row_vertex[id2];
+        const auto &table = TNodeTable::instance();
+        auto call = std::lower_bound(pkb.call_rows.begin(), pkb.call_rows.end(), id1);
+        const auto last = std::lower_bound(call, pkb.call_rows.end(), pkb.subtree_exit[id1]);
+        for (; call != last; ++call) {
+            const CallGraph::Vertex callee = pkb.procedure_vertex.at(table.first_child[*call]);
+            if (callee == procedure2 || pkb.call_graph.reaches(callee, procedure2)) {
                 return true;
-            } else if (child->get_tnode_type() != TN_FACTOR) {
-                result = parentT(child, node2) ? true : result;
             }
         }
-        return result;
+        return false;
     }
 
-    static bool follows(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
+    static bool follows(const TNode node1, const TNode node2) {
         if (!is_statement(node1)) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Node1 is not a statement node.");
         } else if (!is_statement(node2)) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Node2 is not a statement node.");
         }
 
-        if (node1->get_right_sibling() == node2) {
+        if (node1.get_right_sibling() == node2) {
             return true;
         } else {
             return false;
         }
     }
 
-    static bool followsT(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
+    static bool followsT(const TNode node1, const TNode node2) {
         if (!is_statement(node1)) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Node1 is not a statement node.");
         } else if (!is_statement(node2)) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Node2 is not a statement node.");
         }
 
-        bool result = false;
-        if (node1->get_right_sibling() == node2) {
-            return true;
-        } else if (node1->get_right_sibling() != nullptr) {
-            result = followsT(node1->get_right_sibling(), node2) ? true : result;
-        }
-        return result;
+        // statements of one list, node2 after node1
+        const auto &pkb = PKB::instance();
+        return pkb.stmt_list[node1.get_id()] == pkb.stmt_list[node2.get_id()] &&
+               pkb.stmt_slot[node1.get_id()] < pkb.stmt_slot[node2.get_id()];
     }
 
-    static bool can_modify(const std::shared_ptr<TNode> &node) {
+    static bool can_modify(const TNode node) {
         static const std::unordered_set allowedTypes = {
             TN_CALL, TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN
          };
 
-        if (allowedTypes.count(node->get_tnode_type()))
+        if (allowedTypes.count(node.get_tnode_type()))
             return true;
         return false;
     }
 
-    static bool modifies(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node2->get_tnode_type() != TN_FACTOR && node2->get_tnode_type() != TN_ASSIGN) {
+    static bool modifies(const TNode node1, const TNode node2) {
+        if (node2.get_tnode_type() != TN_FACTOR && node2.get_tnode_type() != TN_ASSIGN) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Only factor or assignment can be modified.");
         }
-        switch (node1->get_tnode_type()) {
+        switch (node1.get_tnode_type()) {
         case TN_CALL:
         case TN_PROCEDURE:
         case TN_WHILE:
@@ -427,7 +1207,7 @@ public:
             return false;
         }
         case TN_ASSIGN: {
-            if (node1->get_first_child() == node2) {
+            if (node1.get_first_child() == node2) {
                 return true;
             } else {
                 return false;
@@ -439,11 +1219,11 @@ public:
         }
     }
 
-    static bool uses(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node2->get_tnode_type() != TN_FACTOR && node2->get_tnode_type() != TN_ASSIGN) {
+    static bool uses(const TNode node1, const TNode node2) {
+        if (node2.get_tnode_type() != TN_FACTOR && node2.get_tnode_type() != TN_ASSIGN) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Only factor or assignment can be used.");
         }
-        switch (node1->get_tnode_type()) {
+        switch (node1.get_tnode_type()) {
         case TN_CALL:
         case TN_PROCEDURE: {
             for (const auto &child: get_tnode_children(node1)) {
@@ -453,17 +1233,16 @@ public:
         }
         case TN_IF:
         case TN_WHILE: {
-            if (node1->get_first_child() == node2) { return true; }
-            std::vector<std::shared_ptr<TNode>> children = get_tnode_children(node1);
-            children.erase(children.begin()); // ignoring first child (conditional variable)
+            if (node1.get_first_child() == node2) { return true; }
+            // the first child (conditional variable) is a factor and uses nothing
             for (const auto &child: get_tnode_children(node1)) {
                 if (uses(child, node2)) { return true; }
             }
             return false;
         }
         case TN_ASSIGN: {
-            const std::shared_ptr<TNode> child = node1->get_first_child()->get_right_sibling();
-            if (child->get_tnode_type() == TN_FACTOR) {
+            const TNode child = node1.get_first_child().get_right_sibling();
+            if (child.get_tnode_type() == TN_FACTOR) {
                 if (child == node2) {
                     return true;
                 } else {
@@ -477,7 +1256,7 @@ public:
         case TN_EXPRESSION: {
             bool result = false;
             for (const auto &child: get_tnode_children(node1)) {
-                if (child->get_tnode_type() == TN_FACTOR) {
+                if (child.get_tnode_type() == TN_FACTOR) {
                     if (child == node2) {
                         result = true;
                     }
@@ -494,98 +1273,77 @@ public:
         }
     }
 
-    static bool calls(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node2->get_tnode_type() != TN_PROCEDURE) {
+    static bool calls(const TNode node1, const TNode node2) {
+        if (node2.get_tnode_type() != TN_PROCEDURE) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Only procedure can be called.");
         }
-        static std::unordered_set allowedTypes = { TN_IF, TN_WHILE };
-
-        if (node1->get_tnode_type() == TN_CALL && node1->get_first_child() == node2) { return true; }
-
-        std::vector<std::shared_ptr<TNode>> children = get_tnode_children(node1);
-        for (const auto &child: children) {
-            if (child->get_tnode_type() == TN_CALL) {
-                if (child->get_first_child() == node2) {
-                    return true;
-                }
-            } else if (allowedTypes.count(child->get_tnode_type())) {
-                for (const auto &grandChild : get_tnode_children(child)) {
-                    if (calls(grandChild, node2)) { return true; }
-                }
-            }
+        const auto &pkb = instance();
+        if (node1.get_tnode_type() == TN_PROCEDURE) {
+            const auto &callees = pkb.call_graph.callees(pkb.procedure_vertex.at(node1.get_id()));
+            return std::find(callees.begin(), callees.end(), pkb.procedure_vertex.at(node2.get_id())) != callees.end();
         }
-        return false;
+        return any_call_below(node1, [&pkb, node2](const CallGraph::Vertex called) {
+            return pkb.root_nodes[called] == node2;
+        });
     }
 
-    static bool callsT(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node2->get_tnode_type() != TN_PROCEDURE) {
+    static bool callsT(const TNode node1, const TNode node2) {
+        if (node2.get_tnode_type() != TN_PROCEDURE) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Only procedure can be called.");
         }
-        static std::unordered_set allowedTypes = { TN_IF, TN_WHILE };
-
-        if (node1->get_tnode_type() == TN_CALL && node1->get_first_child() == node2) { return true; }
-
-        std::vector<std::shared_ptr<TNode>> children = get_tnode_children(node1);
-        for (const auto &child: children) {
-            if (child->get_tnode_type() == TN_CALL) {
-                if (child->get_first_child() == node2) {
-                    return true;
-                }
-                else {
-                    if (callsT(child->get_first_child(), node2)) { return true; }
-                }
-            } else if (allowedTypes.count(child->get_tnode_type())) {
-                for (const auto &grandChild : get_tnode_children(child)) {
-                    if (calls(grandChild, node2)) { return true; }
-                }
-            }
+        const auto &pkb = instance();
+        const CallGraph::Vertex target = pkb.procedure_vertex.at(node2.get_id());
+        if (node1.get_tnode_type() == TN_PROCEDURE) {
+            return pkb.call_graph.reaches(pkb.procedure_vertex.at(node1.get_id()), target);
         }
-        return false;
+        return any_call_below(node1, [&pkb, target](const CallGraph::Vertex called) {
+            return called == target || pkb.call_graph.reaches(called, target);
+        });
     }
 
-    static bool next(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node1->get_tnode_type() == TN_FACTOR || node2->get_tnode_type() == TN_FACTOR) {
+    static bool next(const TNode node1, const TNode node2) {
+        if (node1.get_tnode_type() == TN_FACTOR || node2.get_tnode_type() == TN_FACTOR) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Factors can't be used in this relationship.");
         }
-        if (node1->get_tnode_type() == TN_EXPRESSION || node2->get_tnode_type() == TN_EXPRESSION) {
+        if (node1.get_tnode_type() == TN_EXPRESSION || node2.get_tnode_type() == TN_EXPRESSION) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expressions can't be used in this relationship.");
         }
-        switch (node1->get_tnode_type()) {
+        switch (node1.get_tnode_type()) {
         case TN_PROCEDURE: {
-            if (node1->get_first_child() == node2) {
+            if (node1.get_first_child() == node2) {
                 return true;
             }
             return false;
         }
         case TN_CALL: {
-            if (next(node1->get_first_child(), node2)) {
+            if (next(node1.get_first_child(), node2)) {
                 return true;
             }
             return false;
         }
         // in IF TNode children there is no distinction between then and else stmt, we have to use Nodes instead
         case TN_IF: {
-            if (std::dynamic_pointer_cast<IfStmt>(node1->get_node())->then_stmt_list[0] == node2->get_node() ||
-                   std::dynamic_pointer_cast<IfStmt>(node1->get_node())->else_stmt_list[0] == node2->get_node()) {
+            if (static_cast<IfStmt *>(node1.get_node())->then_stmt_list[0] == node2.get_node() ||
+                   static_cast<IfStmt *>(node1.get_node())->else_stmt_list[0] == node2.get_node()) {
                 return true;
                    }
             return false;
         }
         case TN_WHILE: {
-            if (node1->get_first_child()->get_right_sibling() == node2) {
+            if (node1.get_first_child().get_right_sibling() == node2) {
                 return true;
             }
             return false;
         }
         case TN_ASSIGN: {
-            if (node1->get_right_sibling()) {
-                if (node1->get_right_sibling() == node2) {
+            if (node1.get_right_sibling()) {
+                if (node1.get_right_sibling() == node2) {
                     return true;
                 }
                 return false;
             }
             // node is last statement in the list
-            auto tmpTNode = node1->get_parent()->get_right_sibling();
+            auto tmpTNode = node1.get_parent().get_right_sibling();
             if (tmpTNode && tmpTNode == node2) {
                 return true;
             }
@@ -595,54 +1353,54 @@ public:
         return false;
     }
 
-    static bool nextT(const std::shared_ptr<TNode> &node1, const std::shared_ptr<TNode> &node2) {
-        if (node1->get_tnode_type() == TN_FACTOR || node2->get_tnode_type() == TN_FACTOR) {
+    static bool nextT(const TNode node1, const TNode node2) {
+        if (node1.get_tnode_type() == TN_FACTOR || node2.get_tnode_type() == TN_FACTOR) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Factors can't be used in this relationship.");
         }
-        if (node1->get_tnode_type() == TN_EXPRESSION || node2->get_tnode_type() == TN_EXPRESSION) {
+        if (node1.get_tnode_type() == TN_EXPRESSION || node2.get_tnode_type() == TN_EXPRESSION) {
             fatal_error(__PRETTY_FUNCTION__, __LINE__, "Expressions can't be used in this relationship.");
         }
 
         bool result = false;
-        switch (node1->get_tnode_type()) {
+        switch (node1.get_tnode_type()) {
         case TN_PROCEDURE:
-            if (node1->get_first_child() == node2) {
+            if (node1.get_first_child() == node2) {
                 return true;
-            } else if (node1->get_first_child()) {
-                result = nextT(node1->get_first_child(), node2) ? true : result;
+            } else if (node1.get_first_child()) {
+                result = nextT(node1.get_first_child(), node2) ? true : result;
             }
             break;
         case TN_CALL:
-            if (nextT(node1->get_first_child(), node2)) {
+            if (nextT(node1.get_first_child(), node2)) {
                 return true;
             }
             break;
             // in IF TNode children there is no distinction between then and else stmt, we have to use Nodes instead
         case TN_IF:
-            if (std::dynamic_pointer_cast<IfStmt>(node1->get_node())->then_stmt_list[0] == node2->get_node() ||
-                std::dynamic_pointer_cast<IfStmt>(node1->get_node())->else_stmt_list[0] == node2->get_node()) {
+            if (static_cast<IfStmt *>(node1.get_node())->then_stmt_list[0] == node2.get_node() ||
+                static_cast<IfStmt *>(node1.get_node())->else_stmt_list[0] == node2.get_node()) {
                 return true;
-                } else if (node1->get_first_child()->get_right_sibling()) {
-                    result = nextT(node1->get_first_child()->get_right_sibling(), node2) ? true : result;
+                } else if (node1.get_first_child().get_right_sibling()) {
+                    result = nextT(node1.get_first_child().get_right_sibling(), node2) ? true : result;
                 }
             break;
         case TN_WHILE:
-            if (node1->get_first_child()->get_right_sibling() == node2) {
+            if (node1.get_first_child().get_right_sibling() == node2) {
                 return true;
-            } else if (node1->get_first_child()->get_right_sibling()) {
-                result = nextT(node1->get_first_child()->get_right_sibling(), node2) ? true : result;
+            } else if (node1.get_first_child().get_right_sibling()) {
+                result = nextT(node1.get_first_child().get_right_sibling(), node2) ? true : result;
             }
             break;
         case TN_ASSIGN:
-            if (node1->get_right_sibling()) {
-                if (node1->get_right_sibling() == node2) {
+            if (node1.get_right_sibling()) {
+                if (node1.get_right_sibling() == node2) {
                     return true;
                 } else {
-                    result = nextT(node1->get_right_sibling(), node2) ? true : result;
+                    result = nextT(node1.get_right_sibling(), node2) ? true : result;
                 }
             } else {
                 // node is last statement in the list
-                auto psTNode = node1->get_parent()->get_right_sibling();
+                auto psTNode = node1.get_parent().get_right_sibling();
                 if (psTNode) {
                     if (psTNode == node2) {
                         return true;
@@ -656,111 +1414,823 @@ public:
     }
 
 private:
-    std::vector<std::shared_ptr<TNode>> root_nodes{}; // rootNode for each procedure
-    std::vector<std::shared_ptr<TNode>> tnode_list{};
+    std::vector<TNode> root_nodes{}; // rootNode for each procedure
+    std::unordered_map<const Node *, TNode> root_index{}; // procedure node -> its root TNode
+    std::vector<TNode> tnode_list{};
+    Arena factor_arena; // factors made up for the variable of while, if and assign statements
+    std::vector<Factor *> factors{}; // factor_arena factor for each NameId, made on first use
+    // stmt# -> statement, its type and its procedure, entry 0 is not a statement
+    std::vector<TNodeId> stmt_tnode{TNodeTable::NONE};
+    std::vector<TNode_type> stmt_type{TN_FACTOR};
+    std::vector<TNodeId> stmt_procedure{TNodeTable::NONE};
+    CallGraph call_graph;
+    std::unordered_map<TNodeId, CallGraph::Vertex> procedure_vertex; // procedure root -> its call graph vertex
+    ThreadPool pool; // runs the build steps, one thread per core until set_build_threads
+    // interval labels, see label_tnodes
+    std::vector<TNodeId> subtree_exit;
+    std::vector<CallGraph::Vertex> row_vertex; // row -> call graph vertex of its procedure
+    std::vector<TNodeId> call_rows; // every call, ascending
+    std::vector<TNodeId> list_position; // row -> rank in tnode_list, relations list their pairs in this order
+    bool materialize_parent_star = true; // for the next build
+    bool parent_star_stored = true; // by the last build, see build_pkb_relations
+    size_t parent_star_total = SIZE_MAX; // pairs of Parent* when not stored, SIZE_MAX until counted
+    // statement lists, see index_stmt_lists
+    std::vector<TNodeId> stmt_list; // row -> its list, NONE for rows that are not statements
+    std::vector<TNodeId> stmt_slot; // row -> its place in list_stmts
+    std::vector<TNodeId> list_stmts;
+    std::vector<TNodeId> list_begin; // list -> slot of its first statement
+    std::vector<TNodeId> list_end; // list -> slot after its last statement, list_begin for lists of replaced bodies
+    bool materialize_follows_star = true; // for the next build
+    bool follows_star_stored = true; // by the last build
+
+    // relation vectors in the order of relation_families()
+    enum RelationFamily : size_t {
+        PARENT, PARENT_T, FOLLOWS, FOLLOWS_T, MODIFIES, USES, CALLS, CALLS_T, NEXT, NEXT_T, RELATION_FAMILIES
+    };
+    template<typename Item>
+    class RowLists;
+    // pairs of each relation vector by their left and by their right node, see relation_index
+    std::array<std::array<std::unique_ptr<RowLists<size_t>>, 2>, RELATION_FAMILIES> relation_indexes;
+    // direct design facts by row, see index_design_facts
+    std::unique_ptr<RowLists<TNodeId>> fact_children; // statements a row is Parent of, procedure a call calls
+    std::unique_ptr<RowLists<TNodeId>> fact_uses; // factors a statement uses directly
+    std::vector<TNodeId> fact_modified; // factor an assignment modifies, NONE for other rows
+    std::vector<TNodeId> fact_next; // statement a statement is Follows of, NONE for the last of a list
+    size_t dead_rows = 0; // rows of bodies update_procedure replaced, the table is built again once they are half
+    // ids a walk has seen, in an open addressing table that grows with the walk instead of one slot per row or
+    // procedure, so the scratch of a thread is as large as its largest walk; clear() empties only the slots used
+    class IdSet {
+    public:
+        // whether id was not in the set yet, adding it
+        bool insert(const uint32_t id) {
+            if (2 * (used.size() + 1) > slots.size()) {
+                grow();
+            }
+            size_t slot = find(id);
+            if (slots[slot] == id) {
+                return false;
+            }
+            slots[slot] = id;
+            used.push_back(slot);
+            return true;
+        }
+
+        [[nodiscard]] bool contains(const uint32_t id) const {
+            return !slots.empty() && slots[find(id)] == id;
+        }
+
+        void clear() {
+            for (size_t slot: used) {
+                slots[slot] = EMPTY;
+            }
+            used.clear();
+        }
+
+    private:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+        std::vector<uint32_t> slots;
+        std::vector<size_t> used;
+        unsigned shift = 64; // 64 - log2 of the slots
+
+        // slot of id, or the empty slot it goes in
+        [[nodiscard]] size_t find(const uint32_t id) const {
+            const size_t mask = slots.size() - 1;
+            size_t slot = static_cast<size_t>((id * uint64_t{0x9E3779B97F4A7C15}) >> shift); // Fibonacci hashing
+            while (slots[slot] != EMPTY && slots[slot] != id) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+
+        void grow() {
+            std::vector<uint32_t> ids;
+            ids.reserve(used.size());
+            for (size_t slot: used) {
+                ids.push_back(slots[slot]);
+            }
+            shift = slots.empty() ? 60 : shift - 1; // 16 slots at first, then twice as many
+            slots.assign(slots.empty() ? 16 : 2 * slots.size(), EMPTY);
+            used.clear();
+            for (uint32_t id: ids) {
+                const size_t slot = find(id);
+                slots[slot] = id;
+                used.push_back(slot);
+            }
+        }
+    };
+    // sources walked by one task of add_relations, enough to outweigh handing the task out
+    static constexpr size_t RELATION_TASK_SOURCES = 64;
 
     PKB() = default;
 
-    void build_pkb_relations() const {
-        static std::unordered_set allowedTypes1 = { TN_IF };
-        static std::unordered_set allowedTypes2 = { TN_IF };
-
-        for (const auto &node1: tnode_list) {
-            for (const auto &node2 : tnode_list) {
-                if (node1 == node2) { continue; }
-                allowedTypes1 = { TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                allowedTypes2 = { TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    parent(node1, node2)) {
-                    parentRelations->emplace_back(*node1, *node2);
+    // whether matches(procedure vertex) holds for a procedure called by node or by a call statement below it,
+    // without following calls into the called procedures: the calls in the row range of its subtree
+    template<typename Predicate>
+    static bool any_call_below(const TNode node, Predicate matches) {
+        const auto &pkb = instance();
+        const auto &table = TNodeTable::instance();
+        auto call = std::lower_bound(pkb.call_rows.begin(), pkb.call_rows.end(), node.get_id());
+        const auto last = std::lower_bound(call, pkb.call_rows.end(), pkb.subtree_exit[node.get_id()]);
+        for (; call != last; ++call) {
+            if (matches(pkb.procedure_vertex.at(table.first_child[*call]))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // call graph of the procedures in root_nodes, from the call statements of their bodies
+    void build_call_graph() {
+        const auto &table = TNodeTable::instance();
+        procedure_vertex.clear();
+        for (size_t vertex = 0; vertex < root_nodes.size(); ++vertex) {
+            procedure_vertex.emplace(root_nodes[vertex].get_id(), static_cast<CallGraph::Vertex>(vertex));
+        }
+        // the calls of each procedure are collected on the pool
+        std::vector<std::vector<CallGraph::Vertex>> callees(root_nodes.size());
+        pool.parallel_for(root_nodes.size(), [&](size_t vertex) {
+            for (TNodeId id: procedure_nodes(root_nodes[vertex])) {
+                if (table.type[id] == TN_CALL) {
+                    callees[vertex].push_back(procedure_vertex.at(table.first_child[id]));
+                }
+            }
+        });
+        call_graph.reset(root_nodes.size());
+        for (size_t vertex = 0; vertex < root_nodes.size(); ++vertex) {
+            for (CallGraph::Vertex callee: callees[vertex]) {
+                call_graph.add_call(static_cast<CallGraph::Vertex>(vertex), callee);
+            }
+        }
+        call_graph.finalize(pool);
+    }
+
+    // the procedure's root and every row below it, without following calls into other procedures
+    static std::vector<TNodeId> procedure_nodes(const TNode root) {
+        const auto &table = TNodeTable::instance();
+        std::vector<TNodeId> result{root.get_id()};
+        for (size_t i = 0; i < result.size(); ++i) {
+            if (table.type[result[i]] == TN_CALL) {
+                continue;
+            }
+            for (TNodeId child = table.first_child[result[i]]; child != TNodeTable::NONE;
+                 child = table.right_sibling[child]) {
+                result.push_back(child);
+            }
+        }
+        return result;
+    }
+
+    // procedure roots in the order the procedures appear in the source
+    [[nodiscard]] std::vector<TNode> procedures_in_source_order() const {
+        std::vector<TNode> procedures = root_nodes;
+        std::sort(procedures.begin(), procedures.end(), [](const TNode a, const TNode b) {
+            return static_cast<Procedure *>(a.get_node())->source_index <
+                   static_cast<Procedure *>(b.get_node())->source_index;
+        });
+        return procedures;
+    }
+
+    // the procedures laid out from row first on, by row: each one's root and the row after its rows. Every row from
+    // first on belongs to one of them, add_procedures and update_procedure lay procedures out back to back
+    [[nodiscard]] std::vector<std::pair<CallGraph::Vertex, TNodeId>> procedures_from(const TNodeId first) const {
+        std::vector<std::pair<CallGraph::Vertex, TNodeId>> procedures;
+        for (size_t vertex = 0; vertex < root_nodes.size(); ++vertex) {
+            if (root_nodes[vertex].get_id() >= first) {
+                procedures.emplace_back(static_cast<CallGraph::Vertex>(vertex), TNodeTable::NONE);
+            }
+        }
+        std::sort(procedures.begin(), procedures.end(), [this](const auto &a, const auto &b) {
+            return root_nodes[a.first].get_id() < root_nodes[b.first].get_id();
+        });
+        for (size_t k = 0; k < procedures.size(); ++k) {
+            procedures[k].second = k + 1 < procedures.size() ? root_nodes[procedures[k + 1].first].get_id()
+                                                             : static_cast<TNodeId>(TNodeTable::instance().size());
+        }
+        return procedures;
+    }
+
+    // interval labels of the layout add_procedures() makes: a row enters its subtree, subtree_exit is the row after
+    // its last descendant, so a node is below another when its row is between the two. A call's subtree is just
+    // the call, the called procedure is laid out on its own. Labels the rows from first on, update_procedure
+    // appends a body and labels only its rows; the rows of tnode_list are ranked here only when all are new.
+    // Procedures are labelled on the pool, each in its own rows
+    void label_tnodes(const TNodeId first = 0) {
+        const auto &table = TNodeTable::instance();
+        const auto rows = static_cast<TNodeId>(table.size());
+        subtree_exit.resize(first);
+        subtree_exit.resize(rows, TNodeTable::NONE);
+        row_vertex.resize(first);
+        row_vertex.resize(rows, CallGraph::NONE);
+        const auto procedures = procedures_from(first);
+        std::vector<std::vector<TNodeId>> calls(procedures.size());
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            const auto [vertex, end] = procedures[k];
+            const TNodeId root = root_nodes[vertex].get_id();
+            for (TNodeId row = end; row-- > root;) {
+                TNodeId exit = row + 1;
+                if (table.type[row] != TN_CALL) {
+                    for (TNodeId child = table.first_child[row]; child != TNodeTable::NONE;
+                         child = table.right_sibling[child]) {
+                        exit = subtree_exit[child]; // the last child ends the subtree
                     }
-                allowedTypes1 = { TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                allowedTypes2 = { TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    parentT(node1, node2)) {
-                    parentTRelations->emplace_back(*node1, *node2);
+                } else {
+                    calls[k].push_back(row);
+                }
+                subtree_exit[row] = exit;
+            }
+            std::fill(row_vertex.begin() + root, row_vertex.begin() + end, vertex);
+        });
+
+        call_rows.erase(std::lower_bound(call_rows.begin(), call_rows.end(), first), call_rows.end());
+        for (const auto &procedure_calls: calls) {
+            call_rows.insert(call_rows.end(), procedure_calls.rbegin(), procedure_calls.rend());
+        }
+        list_position.resize(first);
+        list_position.resize(rows, TNodeTable::NONE);
+        if (first == 0) {
+            for (size_t i = 0; i < tnode_list.size(); ++i) {
+                list_position[tnode_list[i].get_id()] = static_cast<TNodeId>(i);
+            }
+        }
+    }
+
+    // lays the statement lists out back to back in list_stmts, one list per procedure, while and if (then and else
+    // statements are one list, as they are one list of children); a statement's followers are the rest of its list.
+    // Lists the rows from first on, as label_tnodes labels them: the lists and statements of each procedure are
+    // counted on the pool, which places them, then each procedure fills its lists on the pool
+    void index_stmt_lists(const TNodeId first = 0) {
+        constexpr TNodeTypeMask containers = type_mask({TN_PROCEDURE, TN_WHILE, TN_IF});
+        constexpr TNodeTypeMask stmts = type_mask({TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        const auto &table = TNodeTable::instance();
+        const size_t rows = table.size();
+        stmt_list.resize(first);
+        stmt_list.resize(rows, TNodeTable::NONE);
+        stmt_slot.resize(first);
+        stmt_slot.resize(rows, TNodeTable::NONE);
+        if (first == 0) {
+            list_stmts.clear();
+            list_begin.clear();
+            list_end.clear();
+        }
+
+        const auto procedures = procedures_from(first);
+        // lists and slots before each procedure's
+        std::vector<std::pair<TNodeId, TNodeId>> before(procedures.size() + 1);
+        before[0] = {static_cast<TNodeId>(list_end.size()), static_cast<TNodeId>(list_stmts.size())};
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            TNodeId lists = 0;
+            TNodeId slots = 0;
+            for (TNodeId row = root_nodes[procedures[k].first].get_id(); row < procedures[k].second; ++row) {
+                lists += has_type(containers, table.type[row]);
+                slots += has_type(stmts, table.type[row]);
+            }
+            before[k + 1] = {lists, slots};
+        });
+        for (size_t k = 0; k < procedures.size(); ++k) {
+            before[k + 1].first += before[k].first;
+            before[k + 1].second += before[k].second;
+        }
+        list_begin.resize(before.back().first);
+        list_end.resize(before.back().first);
+        list_stmts.resize(before.back().second);
+
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            auto [list, slot] = before[k];
+            for (TNodeId row = root_nodes[procedures[k].first].get_id(); row < procedures[k].second; ++row) {
+                if (!has_type(containers, table.type[row])) {
+                    continue;
+                }
+                list_begin[list] = slot;
+                for (TNodeId child = table.first_child[row]; child != TNodeTable::NONE;
+                     child = table.right_sibling[child]) {
+                    if (table.type[child] != TN_FACTOR) { // not the condition variable
+                        stmt_list[child] = list;
+                        stmt_slot[child] = slot;
+                        list_stmts[slot++] = child;
                     }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                allowedTypes2 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    follows(node1, node2)) {
-                    followsRelations->emplace_back(*node1, *node2);
+                }
+                list_end[list++] = slot;
+            }
+        });
+    }
+
+    // appends the procedures called from the subtree of row that are not marked yet, marking them
+    void add_called_procedures(const TNodeId row, std::vector<CallGraph::Vertex> &called, IdSet &marks) const {
+        const auto &table = TNodeTable::instance();
+        auto call = std::lower_bound(call_rows.begin(), call_rows.end(), row);
+        const auto last = std::lower_bound(call, call_rows.end(), subtree_exit[row]);
+        for (; call != last; ++call) {
+            const CallGraph::Vertex callee = procedure_vertex.at(table.first_child[*call]);
+            if (marks.insert(callee)) {
+                called.push_back(callee);
+            }
+        }
+    }
+
+    // appends the procedures the called ones call, directly or not: their closure rows ORed together
+    void add_called_closure(std::vector<CallGraph::Vertex> &called, IdSet &marks) const {
+        if (called.empty()) {
+            return;
+        }
+        static thread_local std::vector<uint64_t> reached;
+        reached.assign(call_graph.closure_words(), 0);
+        for (CallGraph::Vertex procedure: called) {
+            call_graph.add_reached(procedure, reached.data());
+        }
+        call_graph.for_each_set(reached.data(), [&](const CallGraph::Vertex callee) {
+            if (marks.insert(callee)) {
+                called.push_back(callee);
+            }
+        });
+    }
+
+    // gives statements their stmt# in program order: procedures as they appear in the source, the statements of a
+    // procedure in preorder with then before else, which is the order of their rows. The statements of each
+    // procedure are counted on the pool, which gives each procedure its first stmt#, then numbered on the pool
+    void number_statements() {
+        const std::vector<TNode> procedures = procedures_in_source_order();
+        std::vector<size_t> first(procedures.size() + 1, 1);
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            first[k + 1] = count_statements(procedures[k]);
+        });
+        std::partial_sum(first.begin(), first.end(), first.begin());
+        stmt_tnode.resize(first.back());
+        stmt_type.resize(first.back());
+        stmt_procedure.resize(first.back());
+        pool.parallel_for(procedures.size(), [&](size_t k) {
+            number_statements(procedures[k], first[k]);
+        });
+    }
+
+    [[nodiscard]] size_t count_statements(const TNode procedure) const {
+        constexpr TNodeTypeMask stmts = type_mask({TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        const auto &table = TNodeTable::instance();
+        size_t statements = 0;
+        for (TNodeId row = procedure.get_id(); row < subtree_exit[procedure.get_id()]; ++row) {
+            statements += has_type(stmts, table.type[row]);
+        }
+        return statements;
+    }
+
+    // numbers the statements of procedure from stmt_no on, in stmt_tnode entries that exist already
+    void number_statements(const TNode procedure, size_t stmt_no) {
+        constexpr TNodeTypeMask stmts = type_mask({TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        auto &table = TNodeTable::instance();
+        for (TNodeId row = procedure.get_id(); row < subtree_exit[procedure.get_id()]; ++row) {
+            if (has_type(stmts, table.type[row])) {
+                table.command_no[row] = static_cast<int>(stmt_no);
+                stmt_tnode[stmt_no] = row;
+                stmt_type[stmt_no] = table.type[row];
+                stmt_procedure[stmt_no] = procedure.get_id();
+                ++stmt_no;
+            }
+        }
+    }
+
+    // a Factor only holds its NameId, so one per name is shared by every statement and every rebuild
+    Factor *factor_for(NameId name) {
+        if (name >= factors.size()) {
+            factors.resize(name + 1, nullptr);
+        }
+        if (factors[name] == nullptr) {
+            factors[name] = factor_arena.make<Factor>(name);
+        }
+        return factors[name];
+    }
+
+    // every relation of the program, from the direct design facts the parser recorded or, when it did not record
+    // them, from the same facts collected by one walk over the AST
+    void build_pkb_relations() {
+        for (const auto &relations: relation_families()) {
+            relations->clear();
+        }
+        drop_relation_indexes();
+        parent_star_total = SIZE_MAX;
+        parent_star_stored = materialize_parent_star;
+        if (!parent_star_stored) {
+            std::vector<std::pair<TNode, TNode>>().swap(*parentTRelations); // keeps no memory either
+        }
+        follows_star_stored = materialize_follows_star;
+        if (!follows_star_stored) {
+            std::vector<std::pair<TNode, TNode>>().swap(*followsTRelations);
+        }
+        DesignFacts collected;
+        const DesignFacts *facts = Parser::instance().get_design_facts();
+        if (facts == nullptr) {
+            collected = collect_design_facts();
+            facts = &collected;
+        }
+        index_design_facts(*facts, 0);
+        add_relations(tnode_list);
+    }
+
+    static std::array<std::shared_ptr<std::vector<std::pair<TNode, TNode>>>, RELATION_FAMILIES> relation_families() {
+        return {parentRelations, parentTRelations, followsRelations, followsTRelations, modifiesRelations,
+                usesRelations, callsRelations, callsTRelations, nextRelations, nextTRelations};
+    }
+
+    // the facts the parser reports while parsing, collected from the parsed procedures
+    [[nodiscard]] DesignFacts collect_design_facts() const {
+        DesignFacts facts;
+        for (const TNode root: root_nodes) {
+            facts.add_procedure(static_cast<Procedure *>(root.get_node()));
+        }
+        return facts;
+    }
+
+    // items listed per row, stored back to back
+    template<typename Item = TNodeId>
+    class RowLists {
+    public:
+        RowLists() = default;
+
+        // pairs are (row, item), items of a row keep the order of the pairs
+        RowLists(size_t rows, const std::vector<std::pair<TNodeId, Item>> &pairs) {
+            append(rows, pairs);
+        }
+
+        // items are 0 ... count - 1 in order, item i is listed for row_of(i)
+        template<typename RowOf>
+        RowLists(size_t rows, size_t count, RowOf row_of) : offsets(rows + 1, 0) {
+            for (size_t i = 0; i < count; ++i) {
+                ++offsets[row_of(i) + 1];
+            }
+            for (size_t row = 0; row < rows; ++row) {
+                offsets[row + 1] += offsets[row];
+            }
+            items.resize(count);
+            std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < count; ++i) {
+                items[next[row_of(i)]++] = i;
+            }
+        }
+
+        // lists the rows after the ones listed so far, up to rows - 1; pairs are as for the constructor, with
+        // those rows only
+        void append(size_t rows, const std::vector<std::pair<TNodeId, Item>> &pairs) {
+            const size_t first = offsets.size() - 1;
+            offsets.resize(rows + 1, 0);
+            for (const auto &[row, item]: pairs) {
+                ++offsets[row + 1];
+            }
+            for (size_t row = first; row < rows; ++row) {
+                offsets[row + 1] += offsets[row];
+            }
+            items.resize(offsets[rows]);
+            std::vector<size_t> next(offsets.begin() + static_cast<std::ptrdiff_t>(first), offsets.end() - 1);
+            for (const auto &[row, item]: pairs) {
+                items[next[row - first]++] = item;
+            }
+        }
+
+        [[nodiscard]] const Item *begin(TNodeId row) const { return items.data() + offsets[row]; }
+
+        [[nodiscard]] const Item *end(TNodeId row) const { return items.data() + offsets[row + 1]; }
+
+    private:
+        std::vector<size_t> offsets{0};
+        std::vector<Item> items;
+    };
+
+    // where the pairs of the relation vector of family are by their left (side 0) or right (side 1) node: indices
+    // into the vector, ascending. Built on first use after each build
+    const RowLists<size_t> &relation_index(const size_t family, const size_t side) {
+        auto &index = relation_indexes[family][side];
+        if (!index) {
+            const auto &relations = *relation_families()[family];
+            index = std::make_unique<RowLists<size_t>>(TNodeTable::instance().size(), relations.size(),
+                                                       [&relations, side](size_t i) {
+                                                           const auto &[left, right] = relations[i];
+                                                           return (side == 0 ? left : right).get_id();
+                                                       });
+        }
+        return *index;
+    }
+
+    // the relation vectors changed, their indexes are built again when next used
+    void drop_relation_indexes() {
+        for (auto &sides: relation_indexes) {
+            for (auto &index: sides) {
+                index.reset();
+            }
+        }
+    }
+
+    // factor rows below an expression row that PKB::uses finds used: an expression on the right of an
+    // operator replaces what was found on its left
+    static void add_expression_uses(const TNodeId row, std::vector<TNodeId> &used) {
+        const auto &table = TNodeTable::instance();
+        if (table.type[row] == TN_FACTOR) {
+            used.push_back(row);
+            return;
+        }
+        const size_t start = used.size();
+        for (TNodeId child = table.first_child[row]; child != TNodeTable::NONE; child = table.right_sibling[child]) {
+            if (table.type[child] == TN_FACTOR) {
+                used.push_back(child);
+            } else {
+                used.resize(start);
+                add_expression_uses(child, used);
+            }
+        }
+    }
+
+    // maps the direct design facts of the rows from first on onto their TNodes, for add_relations; the facts of
+    // rows before first are kept, update_procedure appends a body and indexes only its facts
+    void index_design_facts(const DesignFacts &facts, const TNodeId first) {
+        constexpr TNodeTypeMask stmts_and_procedures =
+                type_mask({TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        const auto &table = TNodeTable::instance();
+        const size_t rows = table.size();
+
+        std::unordered_map<const Node *, TNodeId> row_of; // TNode of every statement and procedure
+        for (TNodeId row = first; row < rows; ++row) {
+            if (has_type(stmts_and_procedures, table.type[row])) {
+                row_of.emplace(table.node[row], row);
+            }
+        }
+        const std::vector<TNodeId> &position = list_position;
+
+        std::vector<std::pair<TNodeId, TNodeId>> pairs;
+        for (const auto &[container, stmt]: facts.parent) {
+            pairs.emplace_back(row_of.at(container), row_of.at(stmt));
+        }
+        // a call is Parent of the procedure it calls, add_relations takes that from the call's first_child as
+        // update_procedure gives an edited procedure a new root
+        std::sort(pairs.begin(), pairs.end(), [&position](const auto &a, const auto &b) {
+            return position[a.second] < position[b.second];
+        });
+        if (first == 0) {
+            fact_children = std::make_unique<RowLists<TNodeId>>();
+            fact_uses = std::make_unique<RowLists<TNodeId>>();
+        }
+        fact_children->append(rows, pairs);
+
+        pairs.clear();
+        std::vector<TNodeId> used;
+        for (const Node *stmt: facts.uses) {
+            const TNodeId row = row_of.at(stmt);
+            used.clear();
+            if (table.type[row] == TN_ASSIGN) {
+                add_expression_uses(table.right_sibling[table.first_child[row]], used);
+            } else {
+                used.push_back(table.first_child[row]); // condition variable
+            }
+            for (TNodeId factor: used) {
+                pairs.emplace_back(row, factor);
+            }
+        }
+        fact_uses->append(rows, pairs);
+
+        fact_modified.resize(first);
+        fact_modified.resize(rows, TNodeTable::NONE);
+        for (const Assign *assign: facts.modifies) {
+            const TNodeId row = row_of.at(assign);
+            fact_modified[row] = table.first_child[row];
+        }
+        fact_next.resize(first);
+        fact_next.resize(rows, TNodeTable::NONE);
+        for (const auto &[stmt, next]: facts.follows) {
+            fact_next[row_of.at(stmt)] = row_of.at(next);
+        }
+    }
+
+    // appends every relation starting at one of sources to the relation vectors, found from the direct design facts
+    // index_design_facts mapped onto TNodes instead of by checking every pair of nodes. Parent*, Modifies and Uses
+    // are collected by scanning the row ranges of the subtree of each source and of the procedures it calls (see
+    // label_tnodes), Follows* is copied from list_stmts, the slots after the source's stmt_slot up to the list_end of
+    // its stmt_list (see index_stmt_lists), Calls* comes from the call graph and Next* along the control flow steps
+    // PKB::nextT takes. Each walk visits a node once, so the time is linear in the facts and the pairs found. For
+    // each source, in the order given, pairs come in tnode_list order of their second node, as checking the pairs
+    // would add them
+    void add_relations(const std::vector<TNode> &sources) {
+        constexpr TNodeTypeMask stmts_and_procedures =
+                type_mask({TN_PROCEDURE, TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        constexpr TNodeTypeMask stmts = type_mask({TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL});
+        constexpr TNodeTypeMask callers = type_mask({TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE});
+        const auto &table = TNodeTable::instance();
+        const RowLists<TNodeId> &children = *fact_children;
+        const RowLists<TNodeId> &uses_of = *fact_uses;
+        const std::vector<TNodeId> &modified = fact_modified;
+        const std::vector<TNodeId> &next_stmt = fact_next;
+        const std::vector<TNodeId> &position = list_position;
+        auto by_position = [&position](TNodeId a, TNodeId b) {
+            return position[a] < position[b];
+        };
+
+        // a step of PKB::nextT from a node: the nodes it reaches directly and the node it goes on from
+        auto next_step = [this, &table](const TNodeId id, std::vector<TNodeId> &reached) {
+            switch (table.type[id]) {
+                case TN_PROCEDURE:
+                case TN_WHILE: {
+                    // first statement, after the condition variable of a while
+                    TNodeId first = table.first_child[id];
+                    if (first != TNodeTable::NONE && table.type[id] == TN_WHILE) {
+                        first = table.right_sibling[first];
                     }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                allowedTypes2 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    followsT(node1, node2)) {
-                    followsTRelations->emplace_back(*node1, *node2);
+                    if (first != TNodeTable::NONE) {
+                        reached.push_back(first);
                     }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL, TN_PROCEDURE };
-                allowedTypes2 = { TN_FACTOR, TN_ASSIGN };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    modifies(node1, node2)) {
-                    modifiesRelations->emplace_back(*node1, *node2);
+                    return first;
+                }
+                case TN_CALL:
+                    return table.first_child[id]; // on from the called procedure
+                case TN_IF: {
+                    // then and else statements are one list, after the condition variable
+                    const TNodeId then_first = table.right_sibling[table.first_child[id]];
+                    const size_t then_size = static_cast<IfStmt *>(table.node[id])->then_stmt_list.size();
+                    reached.push_back(then_first);
+                    reached.push_back(list_stmts[stmt_slot[then_first] + then_size]);
+                    return then_first;
+                }
+                case TN_ASSIGN: {
+                    TNodeId next = table.right_sibling[id];
+                    if (next == TNodeTable::NONE) {
+                        next = table.right_sibling[table.parent[id]]; // last of its list
                     }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_ASSIGN, TN_CALL, TN_PROCEDURE };
-                allowedTypes2 = { TN_FACTOR, TN_ASSIGN };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    uses(node1, node2)) {
-                    usesRelations->emplace_back(*node1, *node2);
+                    if (next != TNodeTable::NONE) {
+                        reached.push_back(next);
                     }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE };
-                allowedTypes2 = { TN_PROCEDURE };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    calls(node1, node2)) {
-                    callsRelations->emplace_back(*node1, *node2);
+                    return next;
                 }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE };
-                allowedTypes2 = { TN_PROCEDURE };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    callsT(node1, node2)) {
-                    callsTRelations->emplace_back(*node1, *node2);
+                default:
+                    return TNodeTable::NONE;
+            }
+        };
+
+        // the walks from the sources are independent: tasks of RELATION_TASK_SOURCES sources run on a work stealing
+        // pool, each thread walks with its own scratch and appends to its own buffers, then the pairs of every task
+        // are copied out in task order, so the relations do not depend on the thread count
+        struct Worker {
+            // cleared for every source
+            IdSet seen_step; // nodes the Next* walk went on from
+            IdSet seen_procedure; // procedures called
+            std::vector<TNodeId> reached;
+            std::vector<TNodeId> modified_rows;
+            std::vector<TNodeId> used_rows;
+            std::vector<CallGraph::Vertex> called;
+            std::array<std::vector<std::pair<TNode, TNode>>, RELATION_FAMILIES> relations;
+        };
+        // where the pairs of a task are in the buffers of the thread that ran it
+        struct TaskSpan {
+            size_t worker = 0;
+            std::array<size_t, RELATION_FAMILIES> begin{};
+            std::array<size_t, RELATION_FAMILIES> end{};
+        };
+        const size_t tasks = (sources.size() + RELATION_TASK_SOURCES - 1) / RELATION_TASK_SOURCES;
+        std::vector<Worker> workers(pool.worker_count(tasks));
+        std::vector<TaskSpan> spans(tasks);
+
+        auto emit = [&by_position](std::vector<TNodeId> &targets, const TNode node1, auto &relations) {
+            std::sort(targets.begin(), targets.end(), by_position);
+            for (TNodeId target: targets) {
+                relations.emplace_back(node1, TNode(target));
+            }
+        };
+
+        auto walk = [&](const size_t i, Worker &worker) {
+            const TNode node1 = sources[i];
+            const TNodeId id1 = node1.get_id();
+            if (!has_type(stmts_and_procedures, table.type[id1])) {
+                return;
+            }
+            auto &seen_step = worker.seen_step;
+            auto &seen_procedure = worker.seen_procedure;
+            auto &reached = worker.reached;
+            auto &modified_rows = worker.modified_rows;
+            auto &used_rows = worker.used_rows;
+            auto &called = worker.called;
+            auto &out = worker.relations;
+            for (const TNodeId *child = children.begin(id1); child != children.end(id1); ++child) {
+                out[PARENT].emplace_back(node1, TNode(*child));
+            }
+            if (table.type[id1] == TN_CALL) {
+                out[PARENT].emplace_back(node1, TNode(table.first_child[id1]));
+            }
+
+            // Parent*, Modifies and Uses: the subtree of node1 and the procedures called from it, directly or not.
+            // The subtree is one range of rows, so is each procedure
+            called.clear();
+            seen_procedure.clear();
+            add_called_procedures(id1, called, seen_procedure);
+            const size_t called_directly = called.size();
+            add_called_closure(called, seen_procedure);
+
+            reached.clear();
+            modified_rows.clear();
+            used_rows.clear();
+            auto scan = [&](const std::pair<TNodeId, TNodeId> subtree) {
+                for (TNodeId row = subtree.first; row < subtree.second; ++row) {
+                    if (modified[row] != TNodeTable::NONE) {
+                        modified_rows.push_back(modified[row]);
+                    }
+                    used_rows.insert(used_rows.end(), uses_of.begin(row), uses_of.end(row));
+                    if (row != id1 && has_type(stmts_and_procedures, table.type[row])) {
+                        reached.push_back(row);
+                    }
                 }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE, TN_ASSIGN };
-                allowedTypes2 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE, TN_ASSIGN };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    next(node1, node2)) {
-                    nextRelations->emplace_back(*node1, *node2);
+            };
+            // in a recursive procedure the subtree is part of a called one
+            if (!seen_procedure.contains(row_vertex[id1])) {
+                scan(get_subtree(node1));
+            }
+            for (CallGraph::Vertex procedure: called) {
+                scan(get_subtree(root_nodes[procedure]));
+            }
+            if (parent_star_stored) {
+                emit(reached, node1, out[PARENT_T]);
+            }
+            emit(modified_rows, node1, out[MODIFIES]);
+            emit(used_rows, node1, out[USES]);
+
+            if (has_type(stmts, table.type[id1])) {
+                if (next_stmt[id1] != TNodeTable::NONE) {
+                    out[FOLLOWS].emplace_back(node1, TNode(next_stmt[id1]));
                 }
-                allowedTypes1 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE, TN_ASSIGN };
-                allowedTypes2 = { TN_WHILE, TN_IF, TN_CALL, TN_PROCEDURE, TN_ASSIGN };
-                if (allowedTypes1.count(node1->get_tnode_type()) &&
-                    allowedTypes2.count(node2->get_tnode_type()) &&
-                    nextT(node1, node2)) {
-                    nextTRelations->emplace_back(*node1, *node2);
+                if (follows_star_stored) {
+                    const TNodeId list = stmt_list[id1];
+                    reached.assign(list_stmts.begin() + stmt_slot[id1] + 1, list_stmts.begin() + list_end[list]);
+                    emit(reached, node1, out[FOLLOWS_T]);
                 }
             }
-        }
-    }
 
-    void build_AST() {
-        if (!Parser::instance().initialized) {
-            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Parser is not initialized.");
-            return;
-        }
+            if (has_type(callers, table.type[id1])) {
+                reached.clear();
+                for (size_t k = 0; k < called_directly; ++k) {
+                    reached.push_back(root_nodes[called[k]].get_id());
+                }
+                reached.erase(std::remove(reached.begin(), reached.end(), id1), reached.end());
+                emit(reached, node1, out[CALLS]);
 
-        auto procedures_map = Parser::instance().get_all_procedures();
-        set_tnode_relations(procedures_map);
-    }
+                reached.clear();
+                for (CallGraph::Vertex callee: called) {
+                    reached.push_back(root_nodes[callee].get_id());
+                }
+                reached.erase(std::remove(reached.begin(), reached.end(), id1), reached.end());
+                emit(reached, node1, out[CALLS_T]);
+            }
+
+            // Next is the first step of Next*, from a call it is the step of the called procedure
+            reached.clear();
+            next_step(table.type[id1] == TN_CALL ? table.first_child[id1] : id1, reached);
+            reached.erase(std::remove(reached.begin(), reached.end(), id1), reached.end());
+            emit(reached, node1, out[NEXT]);
+
+            reached.clear();
+            seen_step.clear();
+            for (TNodeId current = id1; current != TNodeTable::NONE && seen_step.insert(current);) {
+                current = next_step(current, reached);
+            }
+            // each node once, and not node1 itself
+            std::sort(reached.begin(), reached.end(), by_position);
+            reached.erase(std::unique(reached.begin(), reached.end()), reached.end());
+            reached.erase(std::remove(reached.begin(), reached.end(), id1), reached.end());
+            for (TNodeId target: reached) {
+                out[NEXT_T].emplace_back(node1, TNode(target));
+            }
+        };
 
-    std::shared_ptr<TNode> find_node_in_roots(const std::shared_ptr<Node>& node) {
-        for (auto tnode : root_nodes) {
-            if (tnode->get_node() == node) {
-                return tnode;
+        pool.parallel_for_stealing(tasks, [&](size_t task, size_t w) {
+            Worker &worker = workers[w];
+            TaskSpan &span = spans[task];
+            span.worker = w;
+            for (size_t f = 0; f < RELATION_FAMILIES; ++f) {
+                span.begin[f] = worker.relations[f].size();
+            }
+            const size_t end = std::min(sources.size(), (task + 1) * RELATION_TASK_SOURCES);
+            for (size_t i = task * RELATION_TASK_SOURCES; i < end; ++i) {
+                walk(i, worker);
+            }
+            for (size_t f = 0; f < RELATION_FAMILIES; ++f) {
+                span.end[f] = worker.relations[f].size();
+            }
+        });
+
+        // one task per relation family
+        const auto families = relation_families();
+        pool.parallel_for(RELATION_FAMILIES, [&](size_t f) {
+            auto &relations = *families[f];
+            size_t total = relations.size();
+            for (const TaskSpan &span: spans) {
+                total += span.end[f] - span.begin[f];
             }
+            relations.reserve(total);
+            for (const TaskSpan &span: spans) {
+                const auto &buffer = workers[span.worker].relations[f];
+                relations.insert(relations.end(), buffer.begin() + static_cast<std::ptrdiff_t>(span.begin[f]),
+                                 buffer.begin() + static_cast<std::ptrdiff_t>(span.end[f]));
+            }
+        });
+    }
+
+    TNode find_node_in_roots(const Node *node) {
+        auto it = root_index.find(node);
+        if (it != root_index.end()) {
+            return it->second;
         }
 
         fatal_error(__PRETTY_FUNCTION__, __LINE__, "Node not found.");
-        return nullptr;
+        return TNode();
     }
 };
 
@@ -0,0 +1,87 @@
+#include "source_buffer.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+
+namespace {
+    bool read_buffered(const std::string &filePath, std::string &code) {
+        std::ifstream t(filePath, std::ios::binary);
+        if (!t) {
+            return false;
+        }
+        std::ostringstream buffer;
+        buffer << t.rdbuf();
+        code = std::move(buffer).str();
+        return true;
+    }
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_string(std::string code) {
+    std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+    buffer->owned = std::move(code);
+    buffer->data = buffer->owned.data();
+    buffer->size = buffer->owned.size();
+    return buffer;
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_file(const std::string &filePath) {
+#if !defined(_WIN32)
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot open file " + filePath);
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        auto length = static_cast<size_t>(st.st_size);
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            close(fd);
+            madvise(mapping, length, MADV_SEQUENTIAL);
+
+            std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+            buffer->mapping = mapping;
+            buffer->data = static_cast<const char *>(mapping);
+            buffer->size = length;
+            return buffer;
+        }
+    }
+
+    // not a regular file (pipe, stdin, ...) or mapping failed
+    std::string code;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        code.append(chunk, static_cast<size_t>(n));
+    }
+    close(fd);
+    if (n < 0) {
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot read file " + filePath);
+        return nullptr;
+    }
+    return from_string(std::move(code));
+#else
+    std::string code;
+    if (!read_buffered(filePath, code)) {
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot open file " + filePath);
+        return nullptr;
+    }
+    return from_string(std::move(code));
+#endif
+}
+
+SourceBuffer::~SourceBuffer() {
+#if !defined(_WIN32)
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+    }
+#endif
+}
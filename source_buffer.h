@@ -0,0 +1,42 @@
+#ifndef MINISPA_SOURCE_BUFFER_H
+#define MINISPA_SOURCE_BUFFER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+#include "utils.h"
+
+// Read-only SIMPLE source text. Regular files are memory-mapped and read in place,
+// pipes / character devices (and platforms without mmap) fall back to a buffered read.
+class SourceBuffer {
+public:
+    static std::shared_ptr<const SourceBuffer> from_file(const std::string &filePath);
+
+    static std::shared_ptr<const SourceBuffer> from_string(std::string code);
+
+    ~SourceBuffer();
+
+    //don't allow copying, views into the buffer would dangle
+    SourceBuffer(SourceBuffer const &) = delete;
+
+    void operator=(SourceBuffer const &) = delete;
+
+    [[nodiscard]] std::string_view view() const {
+        return {data, size};
+    }
+
+    [[nodiscard]] bool is_mapped() const {
+        return mapping != nullptr;
+    }
+
+private:
+    SourceBuffer() = default;
+
+    std::string owned;
+    void *mapping = nullptr;
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+#endif //MINISPA_SOURCE_BUFFER_H
@@ -0,0 +1,63 @@
+#include "source_stream.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<SourceStream> SourceStream::open(const std::string &filePath, size_t chunk_size) {
+    std::shared_ptr<SourceStream> stream(new SourceStream());
+    stream->path = filePath;
+    stream->chunk_size = chunk_size > 0 ? chunk_size : DEFAULT_CHUNK_SIZE;
+#if !defined(_WIN32)
+    stream->fd = ::open(filePath.c_str(), O_RDONLY);
+    if (stream->fd < 0) {
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot open file " + filePath);
+        return nullptr;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+    stream->file.open(filePath, std::ios::binary);
+    if (!stream->file) {
+        fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot open file " + filePath);
+        return nullptr;
+    }
+#endif
+    return stream;
+}
+
+size_t SourceStream::read_chunk(std::string &out) {
+    size_t old_size = out.size();
+    out.resize(old_size + chunk_size);
+    size_t total = 0;
+#if !defined(_WIN32)
+    // a pipe may return less than asked for, keep reading until the chunk is full or the input ends
+    while (total < chunk_size) {
+        ssize_t n = read(fd, out.data() + old_size + total, chunk_size - total);
+        if (n < 0) {
+            out.resize(old_size);
+            fatal_error(__PRETTY_FUNCTION__, __LINE__, "Cannot read file " + path);
+            return 0;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += static_cast<size_t>(n);
+    }
+#else
+    file.read(out.data() + old_size, static_cast<std::streamsize>(chunk_size));
+    total = static_cast<size_t>(file.gcount());
+#endif
+    out.resize(old_size + total);
+    return total;
+}
+
+SourceStream::~SourceStream() {
+#if !defined(_WIN32)
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef MINISPA_SOURCE_STREAM_H
+#define MINISPA_SOURCE_STREAM_H
+
+#include <string>
+#include <memory>
+#include <fstream>
+
+#include "utils.h"
+
+// SIMPLE source read front to back in chunks, for programs too large to keep in memory.
+// Only the chunk being lexed is resident, see Lexer's streaming mode.
+class SourceStream {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+    static std::shared_ptr<SourceStream> open(const std::string &filePath, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    ~SourceStream();
+
+    SourceStream(SourceStream const &) = delete;
+
+    void operator=(SourceStream const &) = delete;
+
+    // appends up to chunk_size bytes to out, returns how many were read (0 at the end of the file)
+    size_t read_chunk(std::string &out);
+
+    [[nodiscard]] size_t get_chunk_size() const {
+        return chunk_size;
+    }
+
+private:
+    SourceStream() = default;
+
+    std::string path;
+    size_t chunk_size = DEFAULT_CHUNK_SIZE;
+#if defined(_WIN32)
+    std::ifstream file;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif //MINISPA_SOURCE_STREAM_H
@@ -0,0 +1,214 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(size_t threads) {
+    start(threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+size_t ThreadPool::resolve_thread_count(size_t requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    size_t cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+void ThreadPool::resize(size_t threads) {
+    if (resolve_thread_count(threads) == size()) {
+        return;
+    }
+    stop();
+    start(threads);
+}
+
+void ThreadPool::start(size_t threads) {
+    stopping = false;
+    threads = resolve_thread_count(threads);
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(&ThreadPool::work, this, t, job_generation);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread: workers) {
+        thread.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::work(size_t t, size_t generation) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || job_generation != generation; });
+        if (stopping) {
+            return;
+        }
+        // a job never starts before every worker of the previous one is done, so no job this thread takes part
+        // in can be skipped
+        generation = job_generation;
+        if (t >= job_threads) {
+            continue;
+        }
+        const std::function<void(size_t)> &task = *job;
+        lock.unlock();
+        task(t);
+        lock.lock();
+        if (--job_pending == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::run(size_t threads, const std::function<void(size_t)> &task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) {
+            return false;
+        }
+        running = true;
+        job = &task;
+        job_threads = threads;
+        job_pending = threads - 1;
+        ++job_generation;
+    }
+    wake.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return job_pending == 0; });
+    job = nullptr;
+    running = false;
+    return true;
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &body) {
+    size_t threads = std::min(size(), count);
+
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    size_t error_index = count;
+    std::exception_ptr error;
+
+    auto worker = [&](size_t) {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            try {
+                body(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (i < error_index) {
+                    error_index = i;
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    if (threads <= 1 || !run(threads, worker)) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::worker_count(size_t count) const {
+    return std::max<size_t>(1, std::min(size(), count));
+}
+
+void ThreadPool::parallel_for_stealing(size_t count, const std::function<void(size_t, size_t)> &body) {
+    size_t threads = worker_count(count);
+
+    // indices [begin, end) a thread has left, it takes from the front and thieves from the back
+    struct Share {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    std::vector<Share> shares(threads);
+    for (size_t t = 0; t < threads; ++t) {
+        shares[t].begin = count * t / threads;
+        shares[t].end = count * (t + 1) / threads;
+    }
+    std::mutex error_mutex;
+    size_t error_index = count;
+    std::exception_ptr error;
+
+    // moves the back half of another thread's share to the share of thief, false when every share is empty.
+    // Only one lock is held at a time, a share being moved is done by the thief so no work is lost
+    auto steal = [&](size_t thief) {
+        for (size_t offset = 1; offset < threads; ++offset) {
+            Share &victim = shares[(thief + offset) % threads];
+            size_t begin;
+            size_t end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.begin >= victim.end) {
+                    continue;
+                }
+                end = victim.end;
+                begin = end - (end - victim.begin + 1) / 2;
+                victim.end = begin;
+            }
+            std::lock_guard<std::mutex> lock(shares[thief].mutex);
+            shares[thief].begin = begin;
+            shares[thief].end = end;
+            return true;
+        }
+        return false;
+    };
+
+    auto worker = [&](size_t t) {
+        Share &own = shares[t];
+        while (true) {
+            size_t i = count;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.begin < own.end) {
+                    i = own.begin++;
+                }
+            }
+            if (i == count) {
+                if (!steal(t)) {
+                    return;
+                }
+                continue;
+            }
+            try {
+                body(i, t);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (i < error_index) {
+                    error_index = i;
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    if (threads <= 1 || !run(threads, worker)) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i, 0);
+        }
+        return;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef MINISPA_THREAD_POOL_H
+#define MINISPA_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads that are started once and then run the bodies of every parallel_for handed to the pool, so a build
+// pays for starting them once instead of once per step. The thread calling parallel_for is one of the pool's
+// threads. A parallel_for called from inside a body, or while another thread's parallel_for is running, runs
+// its bodies on the calling thread
+class ThreadPool {
+public:
+    // threads: 0 = one per hardware core
+    explicit ThreadPool(size_t threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // 0 means one thread per hardware core
+    static size_t resolve_thread_count(size_t requested);
+
+    // threads bodies may run on, the caller included
+    [[nodiscard]] size_t size() const {
+        return workers.size() + 1;
+    }
+
+    // stops the pool's threads and starts `threads` (0 = one per core), must not be called while a parallel_for runs
+    void resize(size_t threads);
+
+    // runs body(i) for every i in [0, count) on the pool's threads, indices are handed out one at a time;
+    // if any body throws, the exception of the lowest index is rethrown
+    void parallel_for(size_t count, const std::function<void(size_t)> &body);
+
+    // threads parallel_for_stealing runs `count` bodies on, for sizing per thread state
+    [[nodiscard]] size_t worker_count(size_t count) const;
+
+    // runs body(i, worker) for every i in [0, count), worker < worker_count(count) is the thread running it
+    // (the caller is worker 0) so bodies can keep state per thread. Every thread starts on its own contiguous
+    // share of the indices and, once that is done, steals half of what is left of another thread's share, so
+    // bodies of uneven cost still keep every thread busy; exceptions are rethrown as in parallel_for
+    void parallel_for_stealing(size_t count, const std::function<void(size_t, size_t)> &body);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake; // a job was posted or the pool is stopping
+    std::condition_variable done; // the last worker of a job finished
+    const std::function<void(size_t)> *job = nullptr;
+    size_t job_threads = 0;
+    size_t job_generation = 0; // bumped for every job, tells a worker the job is new
+    size_t job_pending = 0; // workers of the current job that have not finished it
+    bool running = false; // a parallel_for is in progress, later ones run on their caller
+    bool stopping = false;
+
+    // runs task(t) once for every t in [0, threads) with threads <= size(), task(0) on the caller; false without
+    // running anything when the pool is already running a job
+    bool run(size_t threads, const std::function<void(size_t)> &task);
+
+    // loop of worker thread t, generation is the last job started before it, which it does not take part in
+    void work(size_t t, size_t generation);
+
+    void start(size_t threads);
+
+    void stop();
+};
+
+#endif //MINISPA_THREAD_POOL_H